@@ -4,9 +4,14 @@
 #include <vector>
 
 #include "Flag.h"
+#include "bitMatrix.h"
 
 namespace FlagAlgebra {
-	// class Digraph represents digraphs as UTOs
+	/* class Digraph represents digraphs as UTOs
+	 * The adjacency matrix is kept both by rows (out-neighbourhoods) and by columns
+	 * (in-neighbourhoods) as bitsets, so degrees are population counts and arcs in
+	 * either direction are compared a word at a time
+	 */
 	class Digraph {
 	public:
 		Digraph();
@@ -23,6 +28,11 @@ namespace FlagAlgebra {
 		bool operator==(const Digraph&) const;
 		bool operator!=(const Digraph&) const;
 
+		Canonical::certificate_t certificate(morphism* = 0) const;
+		Canonical::certificate_t certificate(const std::vector<unsigned long>&,
+											 morphism* = 0) const;
+		Digraph canonicalForm() const;
+
 		unsigned long outDegree(unsigned long) const;
 		unsigned long inDegree(unsigned long) const;
 
@@ -32,7 +42,15 @@ namespace FlagAlgebra {
 		static container<Digraph> enumerate(unsigned long);
 	protected:
 		unsigned long s;
-		vbool m;
+		// m has the out-neighbourhoods as rows and t the in-neighbourhoods (m transposed)
+		BitMatrix::bitMatrix m, t;
+
+		bool refineAssignment(const Digraph&,
+							  unsigned long,
+							  unsigned long,
+							  unsigned long,
+							  std::vector< std::vector<unsigned long> >&,
+							  std::vector< std::vector<unsigned long> >&) const;
 	};
 }
 
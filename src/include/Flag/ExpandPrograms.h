@@ -4,6 +4,7 @@
 #include "Flag.h"
 #include <cstdio>
 #include <iostream>
+#include <sstream>
 #include <cstring>
 #include "getoptions.h"
 
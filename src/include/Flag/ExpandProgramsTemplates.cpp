@@ -10,11 +10,19 @@ int enumerateProgram(int argc, char **argv) {
 		char opt;
 		const char* arg = "";
 		while (true) {
-			if (Text::getoptions("f", ind1, ind2, opt, arg, argc, argv)) {
+			if (Text::getoptions("ft:", ind1, ind2, opt, arg, argc, argv)) {
 				switch (opt) {
 				case 'f':
 					flagMode = true;
 					break;
+				case 't':
+					std::stringstream(arg) >> maxThreads;
+					break;
+				case ':':
+					std::cerr << "Missing argument for option: " << *arg
+							  << "\nTry `" << argv[0]
+							  << " --help' for more information.\n";
+					return 1;
 				case '\0':
 					std::cerr << "Invalid option: " << *arg
 							  << "\nTry `" << argv[0]
@@ -26,6 +34,8 @@ int enumerateProgram(int argc, char **argv) {
 				std::cerr << "Usage: " << argv[0] << " [options]\n"
 						  << "Enumerate UTO objects.\n\n"
 						  << "  -f  enumerate UTO flags instead.\n"
+						  << "  -t N  use at most N threads to enumerate\n"
+						  << "        (N = 0, the default, means one per hardware thread)\n"
 						  << "\n";
 				return 0;
 			}
@@ -155,11 +165,19 @@ int expandProductProgram(int argc, char **argv) {
 		char opt;
 		const char* arg = "";
 		while (true) {
-			if (Text::getoptions("c", ind1, ind2, opt, arg, argc, argv)) {
+			if (Text::getoptions("ct:", ind1, ind2, opt, arg, argc, argv)) {
 				switch (opt) {
 				case 'c':
 					onlyCoeffs = true;
 					break;
+				case 't':
+					std::stringstream(arg) >> maxThreads;
+					break;
+				case ':':
+					std::cerr << "Missing argument for option: " << *arg
+							  << "\nTry `" << argv[0]
+							  << " --help' for more information.\n";
+					return 1;
 				case '\0':
 					std::cerr << "Invalid option: " << *arg
 							  << "\nTry `" << argv[0]
@@ -171,6 +189,8 @@ int expandProductProgram(int argc, char **argv) {
 				std::cerr << "Usage: " << argv[0] << " [options]\n"
 						  << "Enumerate UTO objects.\n\n"
 						  << "  -c  print only coefficients (with zeros).\n"
+						  << "  -t N  use at most N threads to build the product table\n"
+						  << "        (N = 0, the default, means one per hardware thread)\n"
 						  << "\n";
 				return 0;
 			}
@@ -8,6 +8,10 @@
 #include <cstdio>
 #include <limits>
 #include <utility>
+#include <unordered_map>
+#include <atomic>
+#include <thread>
+#include <mutex>
 #include "Monitoring.h"
 
 /* This is the container of the enumeration
@@ -25,11 +29,19 @@
 #include "injective.h"
 #include "bignum.h"
 #include "selector.h"
+#include "Canonical.h"
 
 
 namespace FlagAlgebra {
 	extern unsigned long fracPrecision;
 	extern unsigned long progressBarSize;
+	extern unsigned long maxThreads;
+	extern std::recursive_mutex memoMutex;
+
+	// Sizes whose memoized enumerations are read without taking memoMutex
+	const unsigned long lockFreeSizes = 64;
+
+	unsigned long threadCount(unsigned long);
 
     typedef std::vector<bool> vbool;
 	typedef mcont<unsigned long> morphism;
@@ -91,6 +103,32 @@ namespace FlagAlgebra {
 		 */
 		bool operator==(const UniversalTheoryObject&) const;
 
+		/* certificate(morphism* pm = 0) const:
+		 * returns: the certificate of the object: two objects have equal certificates
+		 *          iff they are isomorphic (so certificates can be hashed to look
+		 *          objects up up to isomorphism)
+		 * note: if pm is not null, the canonical labelling is put on *pm ((*pm)[v] is
+		 *       the vertex of canonicalForm() that corresponds to v)
+		 */
+		Canonical::certificate_t certificate(morphism* = 0) const;
+
+		/* certificate(const std::vector<unsigned long>& colours, morphism* pm = 0) const:
+		 * restrictions: colours.size() == size()
+		 * returns: the certificate of the object with vertex v coloured colours[v]: two
+		 *          coloured objects have equal certificates iff there is an isomorphism
+		 *          between them that preserves the colours
+		 * note: if pm is not null, the canonical labelling is put on *pm
+		 */
+		Canonical::certificate_t certificate(const std::vector<unsigned long>&,
+											 morphism* = 0) const;
+
+		/* canonicalForm() const:
+		 * returns: the object isomorphic to *this with the canonical labelling (two
+		 *          objects are isomorphic iff their canonical forms are equal as
+		 *          labelled objects)
+		 */
+		UniversalTheoryObject canonicalForm() const;
+
 		/* readFromFile(FILE *f):
 		 * reads an UTO from file f and puts it on *this
 		 * returns: the number of objects read or a negative number in case of error
@@ -132,6 +170,19 @@ namespace FlagAlgebra {
 	template<class UTO>
 	const container<UTO>& enumerateObjects(unsigned long);
 
+	/* Index of the objects of an enumeration by their certificates: the value of a
+	 * certificate is the index of the object and its inverse canonical labelling
+	 */
+	typedef std::unordered_map<Canonical::certificate_t,
+							   std::pair<unsigned long, morphism>,
+							   Canonical::certificateHash> objindex_type;
+
+	template<class UTO>
+	const objindex_type& enumerateObjectsIndex(unsigned long);
+
+	template<class UTO>
+	unsigned long findEnumeratedObject(const UTO&, morphism&);
+
 	template<class UTO>
 	container< Flag<UTO> > enumerateNormalizedTypes(unsigned long);
 
@@ -143,6 +194,17 @@ namespace FlagAlgebra {
 	template<class UTO>
 	container< Flag<UTO> > enumerateFlags(unsigned long, const Flag<UTO>&);
 
+	// Index of the flags of an enumeration by their certificates (values are positions)
+	typedef std::unordered_map<Canonical::certificate_t,
+							   unsigned long,
+							   Canonical::certificateHash> flagindex_type;
+
+	template<class UTO>
+	const flagindex_type& enumerateFlagsIndex(unsigned long, const UTO&);
+
+	template<class UTO>
+	const std::vector<BigNum::frac>& enumerateNormFactors(unsigned long, const UTO&);
+
 	/* Template class for flags of a given Universal Theory
 	 * (the Universal Theory class must have implemented the funcionality described
 	 * by the UTO model class
@@ -172,16 +234,18 @@ namespace FlagAlgebra {
 		bool findIsomorphism(const Flag<UTO>&, morphism&) const;
 		bool operator==(const Flag<UTO>&) const;
 		bool operator!=(const Flag<UTO>&) const;
+		Canonical::certificate_t certificate() const;
 
 		BigNum::frac normFactor() const;
 	private:
 		const UTO* obj;
 		unsigned long objIndex;
 		morphism typev;
-		mutable unsigned long norm;
+		mutable std::atomic<unsigned long> norm;
 
 		Flag(const UTO*, unsigned long, const morphism&);
 		Flag<UTO> normTypeFlag(const container< Flag<UTO> >** = 0, morphism* = 0) const;
+		Canonical::certificate_t typeCertificate() const;
 
 		friend container< Flag<UTO> > enumerateNormalizedTypes<UTO>(unsigned long);
 		friend const container< Flag<UTO> >& enumerateFlags<UTO>(unsigned long,
@@ -189,6 +253,8 @@ namespace FlagAlgebra {
 																 morphism&);
 		friend container< Flag<UTO> > enumerateFlags<UTO>(unsigned long,
 														  const Flag<UTO>&);
+		friend const std::vector<BigNum::frac>& enumerateNormFactors<UTO>(unsigned long,
+																		 const UTO&);
 	};
 
 	// I/O functions for a flag
@@ -234,6 +300,20 @@ namespace FlagAlgebra {
 							   unsigned long,
 							   morphism&);
 
+	/* Type of the counts of a flag product expansion: ((i, j), m) means that m pairs of
+	 * subflags of an expansion flag are isomorphic to the i-th and j-th flags
+	 */
+	typedef std::pair<std::pair<unsigned long, unsigned long>, unsigned long> prodcount_type;
+
+	template<class UTO>
+	void countFlagProducts(const container< Flag<UTO> >*,
+						   const container< Flag<UTO> >*,
+						   const container< Flag<UTO> >*,
+						   unsigned long,
+						   unsigned long,
+						   std::atomic<unsigned long>*,
+						   std::vector< std::vector<prodcount_type> >*);
+
 
 	// SDP problem functions
 	template<class UTO>
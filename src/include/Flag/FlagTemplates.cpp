@@ -44,7 +44,7 @@ void printobj(const UTO& uto) {
  * constructs flag of size 0
  */
 template<class UTO>
-Flag<UTO>::Flag() : obj(), objIndex(), typev(), norm() {
+Flag<UTO>::Flag() : obj(), objIndex(), typev(), norm(0) {
 	obj = &enumerateObjects<UTO>(0)[0];
 }
 
@@ -54,7 +54,7 @@ template<class UTO>
 Flag<UTO>::Flag(const Flag<UTO>& other) : obj(other.obj),
 										  objIndex(other.objIndex),
 										  typev(other.typev),
-										  norm(other.norm) {}
+										  norm(other.norm.load(std::memory_order_relaxed)) {}
 
 /* Flag(const UTO& ob, const morphism& v):
  * constructs a flag whose base object is ob and whose type is specified by v
@@ -68,20 +68,10 @@ template<class UTO>
 Flag<UTO>::Flag(const UTO& ob, const morphism& v) : obj(),
 													objIndex(0),
 													typev(v.size()),
-													norm() {
-	const container<UTO>& objEnum(enumerateObjects<UTO>(ob.size()));
-
+													norm(0) {
 	morphism f;
-	for ( ;
-		  /** The below shouldn't be needed, so it is commented out
-		  objIndex < objEnum.size()
-		  **/
-		  ;
-		  ++objIndex)
-		if (ob.findIsomorphism(objEnum[objIndex], f))
-			break;
-
-	obj = &objEnum[objIndex];
+	objIndex = findEnumeratedObject(ob, f);
+	obj = &enumerateObjects<UTO>(ob.size())[objIndex];
 	for (unsigned long j = 0; j < v.size(); ++j)
 		typev[j] = f[v[j]];
 }
@@ -96,7 +86,7 @@ template<class UTO>
 Flag<UTO>::Flag(const UTO* ob, unsigned long obInd, const morphism& v) : obj(ob),
 																		 objIndex(obInd),
 																		 typev(v),
-																		 norm() {}
+																		 norm(0) {}
 
 /* copy operator
  */
@@ -105,7 +95,7 @@ Flag<UTO>& Flag<UTO>::operator=(const Flag<UTO>& other) {
 	obj = other.obj;
 	objIndex = other.objIndex;
 	typev = other.typev;
-	norm = other.norm;
+	norm.store(other.norm.load(std::memory_order_relaxed), std::memory_order_relaxed);
 	return *this;
 }
 
@@ -270,25 +260,70 @@ bool Flag<UTO>::operator!=(const Flag<UTO>& other) const {
 	return !findIsomorphism(other, f);
 }
 
+/* certificate() const:
+ * returns: the certificate of the flag: two flags have equal certificates iff they are
+ *          isomorphic (as flags)
+ * note: it is the type size followed by the certificate of the object with the j-th
+ *       labeled vertex coloured j + 1 and the unlabeled vertices coloured 0 (so the
+ *       labels are fixed and only the unlabeled vertices are put in canonical order)
+ */
+template<class UTO>
+Canonical::certificate_t Flag<UTO>::certificate() const {
+	std::vector<unsigned long> colours(size());
+	for (unsigned long j = 0; j < typev.size(); ++j)
+		colours[typev[j]] = j + 1;
+	Canonical::certificate_t ret(1, typev.size());
+	const Canonical::certificate_t cert(obj->certificate(colours));
+	ret.insert(ret.end(), cert.begin(), cert.end());
+	return ret;
+}
+
+/* typeCertificate() const:
+ * returns: the certificate of type() (see certificate), computed from the labeled
+ *          subobject without looking it up on enumerateObjects
+ */
+template<class UTO>
+Canonical::certificate_t Flag<UTO>::typeCertificate() const {
+	const vbool lv(labeledVertices());
+	morphism f(size());
+	for (unsigned long i = 0, cnt = 0; i < size(); ++i)
+		if (lv[i])
+			f[i] = cnt++;
+	std::vector<unsigned long> colours(typev.size());
+	for (unsigned long j = 0; j < typev.size(); ++j)
+		colours[f[typev[j]]] = j + 1;
+	Canonical::certificate_t ret(1, typev.size());
+	const Canonical::certificate_t cert(obj->subobject(lv).certificate(colours));
+	ret.insert(ret.end(), cert.begin(), cert.end());
+	return ret;
+}
+
 /* normFactor() const:
  * returns: the normalizing factor of the flag (to type 0)
+ * note: the flags returned by the enumerating functions carry their norms, so for them
+ *       this only reads a field; the other flags look their normalized flags up by
+ *       certificate (see enumerateFlagsIndex) the first time and keep the norm found
+ *       (every thread finds the same norm, so the cache is a relaxed atomic); to get the
+ *       factors of all flags of an enumeration, enumerateNormFactors is faster
  */
 template<class UTO>
 BigNum::frac Flag<UTO>::normFactor() const {
-	if (!norm) {
+	unsigned long n(norm.load(std::memory_order_relaxed));
+	if (!n) {
 		const container< Flag<UTO> >* pcont;
 
 		Flag<UTO> nflag(normTypeFlag(&pcont));
 
-		typename container< Flag<UTO> >::const_iterator it =
-			find(pcont->begin(), pcont->end(), nflag);
+		const flagindex_type& index(enumerateFlagsIndex(size(), nflag.unlabeledType()));
+		flagindex_type::const_iterator it(index.find(nflag.certificate()));
 		/** The below shouldn't be needed, so it is commented out
-		if (it == cont.end())
+		if (it == index.end())
 			throw FlagException("normFactor: can't find flag on enum");
 		**/
-		norm = it->norm;
+		n = (*pcont)[it->second].norm.load(std::memory_order_relaxed);
+		norm.store(n, std::memory_order_relaxed);
 	}
-	return BigNum::frac(BigNum::bignum(norm),
+	return BigNum::frac(BigNum::bignum(n),
 						BigNum::decrescentfactorial(size(), typeSize()));
 }
 
@@ -386,16 +421,84 @@ void printflag(const Flag<UTO>& flag) {
 /* enumerateObjects(unsigned long s):
  * this function guarantees that UTO::enumerate gets called only once for each size
  * returns: container with every UTO object of size s (each one appearing exactly once)
+ * note: the enumerations are built under memoMutex and the ones of sizes below
+ *       lockFreeSizes are then read without locking (so this may be called by several
+ *       threads)
  */
 template<class UTO>
 const container<UTO>& enumerateObjects(unsigned long s) {
 	static std::deque< container<UTO> > mem;
+	static std::atomic<const container<UTO>*> ready[lockFreeSizes];
 
+	if (s < lockFreeSizes) {
+		const container<UTO>* p(ready[s].load(std::memory_order_acquire));
+		if (p)
+			return *p;
+	}
+	std::lock_guard<std::recursive_mutex> lock(memoMutex);
 	if (mem.size() <= s)
 		mem.resize(s+1);
-	if (mem[s].size())
-		return mem[s];
-   	return mem[s] = UTO::enumerate(s);
+	if (!mem[s].size())
+		mem[s] = UTO::enumerate(s);
+	if (s < lockFreeSizes)
+		ready[s].store(&mem[s], std::memory_order_release);
+	return mem[s];
+}
+
+/* enumerateObjectsIndex(unsigned long s):
+ * this function guarantees that the index gets built only once for each size
+ * returns: index of enumerateObjects(s) by certificate (see objindex_type); the inverse
+ *          canonical labelling maps each canonical position to the vertex of the
+ *          enumerated UTO
+ * note: same locking as enumerateObjects
+ */
+template<class UTO>
+const objindex_type& enumerateObjectsIndex(unsigned long s) {
+	static std::deque<objindex_type> mem;
+	static std::atomic<const objindex_type*> ready[lockFreeSizes];
+
+	if (s < lockFreeSizes) {
+		const objindex_type* p(ready[s].load(std::memory_order_acquire));
+		if (p)
+			return *p;
+	}
+	std::lock_guard<std::recursive_mutex> lock(memoMutex);
+	if (mem.size() <= s)
+		mem.resize(s+1);
+	if (!mem[s].size()) {
+		const container<UTO>& objEnum(enumerateObjects<UTO>(s));
+		for (unsigned long i = 0; i < objEnum.size(); ++i) {
+			morphism lab, inv(s);
+			const Canonical::certificate_t cert(objEnum[i].certificate(&lab));
+			for (unsigned long v = 0; v < s; ++v)
+				inv[lab[v]] = v;
+			mem[s][cert] = std::make_pair(i, inv);
+		}
+	}
+	if (s < lockFreeSizes)
+		ready[s].store(&mem[s], std::memory_order_release);
+	return mem[s];
+}
+
+/* findEnumeratedObject(const UTO& ob, morphism& f):
+ * returns: the index of the UTO of enumerateObjects(ob.size()) that is isomorphic to ob
+ *          and puts an isomorphism from ob to it on f
+ * note: it is a lookup on enumerateObjectsIndex (the isomorphism is the canonical
+ *       labelling of ob followed by the inverse canonical labelling of the UTO found)
+ */
+template<class UTO>
+unsigned long findEnumeratedObject(const UTO& ob, morphism& f) {
+	const objindex_type& index(enumerateObjectsIndex<UTO>(ob.size()));
+	morphism lab;
+	objindex_type::const_iterator it(index.find(ob.certificate(&lab)));
+	/** The below shouldn't be needed, so it is commented out
+	if (it == index.end())
+		throw FlagException("findEnumeratedObject: can't find object on enum");
+	**/
+	f.resize(lab.size());
+	for (unsigned long v = 0; v < lab.size(); ++v)
+		f[v] = it->second.second[lab[v]];
+	return it->second.first;
 }
 
 /* enumerateNormalizedTypes(unsigned long s):
@@ -429,12 +532,19 @@ container< Flag<UTO> > enumerateNormalizedTypes(unsigned long s) {
  * object enumerated by enumerateObjects (or are isomorphic to one such)) are kept stored.
  * returns: container with every flag of size s and type Flag(utp,f)
  *          f's initial value is ignored
+ * note: the flags found and their types are looked up by their certificates (see
+ *       Flag::certificate), so each candidate flag is matched to its normalized type
+ *       and counted on its norm in constant expected time
+ *
+ * note: the table is used under memoMutex (so this may be called by several threads),
+ *       as are the ones of enumerateFlagsIndex and enumerateNormFactors
  */
 template<class UTO>
 const container< Flag<UTO> >& enumerateFlags(unsigned long s,
 											 const UTO& utp,
 											 morphism& f) {
 	static std::deque< std::deque< std::deque< container< Flag<UTO> > > > > mem;
+	std::lock_guard<std::recursive_mutex> lock(memoMutex);
 
 	const unsigned long indt(utp.size());
 	const unsigned long inds(s-indt);
@@ -447,48 +557,50 @@ const container< Flag<UTO> >& enumerateFlags(unsigned long s,
 		const container< Flag<UTO> >& ntpEnum(enumerateNormalizedTypes<UTO>(utp.size()));
 		const container<UTO>& baseObjEnum(enumerateObjects<UTO>(s));
 		mem[indt][inds].resize(ntpEnum.size());
+		// positions of the flags in their containers by certificate
+		std::vector< std::unordered_map<Canonical::certificate_t,
+										unsigned long,
+										Canonical::certificateHash> >
+			positions(ntpEnum.size());
+		// indexes of the normalized types by certificate
+		std::unordered_map<Canonical::certificate_t,
+						   unsigned long,
+						   Canonical::certificateHash> typeIndex;
+		for (unsigned long index = 0; index < ntpEnum.size(); ++index)
+			typeIndex[ntpEnum[index].certificate()] = index;
 
 		Injective::injective< mcont<unsigned long> > tv(utp.size(), s);
 		do {
 			for (unsigned long i = 0; i < baseObjEnum.size(); ++i) {
 				Flag<UTO> flag(&baseObjEnum[i], i, tv); // private constructor (faster)
-				Flag<UTO> tp(flag.type());
+				typename std::unordered_map<Canonical::certificate_t,
+											unsigned long,
+											Canonical::certificateHash>::const_iterator
+					it(typeIndex.find(flag.typeCertificate()));
 
-				unsigned long index = 0;
-				for ( ; index < ntpEnum.size(); ++index)
-					if (tp == ntpEnum[index])
-						break;
-				if (index != ntpEnum.size()) {
+				if (it != typeIndex.end()) {
+					const unsigned long index(it->second);
 					container< Flag<UTO> >& flagcont(mem[indt][inds][index]);
-					typename container< Flag<UTO> >::iterator jt =
-						find(flagcont.begin(), flagcont.end(), flag);
-					if (jt == flagcont.end()) {
+					std::pair<typename std::unordered_map<Canonical::certificate_t,
+														  unsigned long,
+														  Canonical::certificateHash>
+							  ::iterator,
+							  bool>
+						ins(positions[index].insert(std::make_pair(flag.certificate(),
+																   flagcont.size())));
+					if (ins.second) {
 						flag.norm = 1;
 						flagcont.push_back(flag);
 					}
 					else {
-						++jt->norm;
+						++flagcont[ins.first->second].norm;
 					}
 				}
 			}
 		} while (tv.next());
 	}
 
-	const container<UTO>& utpEnum(enumerateObjects<UTO>(utp.size()));
-	unsigned long index = 0;
-	for ( ;
-		  /** This should never happen so it is commented out
-		  index < utpEnum.size()
-		  **/
-		  ;
-		  ++index)
-		if (utp.findIsomorphism(utpEnum[index], f))
-			break;
-	/** The below should never happen, so it is commented out
-	if (index == utpEnum.size())
-		throw FlagException("enumerateFlags: can't find unlabeled type on enum");
-	**/
-	return mem[indt][inds][index];
+	return mem[indt][inds][findEnumeratedObject(utp, f)];
 }
 
 
@@ -524,6 +636,75 @@ container< Flag<UTO> > enumerateFlags(unsigned long s, const Flag<UTO>& tp) {
 
 		ret.push_back(Flag<UTO>(cont[i].obj, cont[i].objectIndex(),	g));
 		// private constructor (faster)
+		// relabeling the type does not change the norm
+		ret.back().norm.store(cont[i].norm.load(std::memory_order_relaxed),
+							  std::memory_order_relaxed);
+	}
+	return ret;
+}
+
+
+/* enumerateFlagsIndex(unsigned long s, const UTO& utp):
+ * restrictions: s >= utp.size()
+ * this function guarantees that the index gets built only once for each normalized type
+ * returns: index by certificate (see Flag::certificate) of the container of
+ *          enumerateFlags(s, utp, f) (the value of each certificate is the position of
+ *          the flag on the container)
+ */
+template<class UTO>
+const flagindex_type& enumerateFlagsIndex(unsigned long s, const UTO& utp) {
+	static std::deque< std::deque< std::deque<flagindex_type> > > mem;
+	std::lock_guard<std::recursive_mutex> lock(memoMutex);
+
+	morphism f;
+	const container< Flag<UTO> >& cont(enumerateFlags<UTO>(s, utp, f));
+	const unsigned long indt(utp.size());
+	const unsigned long inds(s-indt);
+	const unsigned long index(findEnumeratedObject(utp, f));
+
+	if (mem.size() <= indt)
+		mem.resize(indt+1);
+	if (mem[indt].size() <= inds)
+		mem[indt].resize(inds+1);
+	if (mem[indt][inds].size() <= index)
+		mem[indt][inds].resize(enumerateObjects<UTO>(indt).size());
+	flagindex_type& ret(mem[indt][inds][index]);
+	if (ret.size() != cont.size())
+		for (unsigned long i = 0; i < cont.size(); ++i)
+			ret[cont[i].certificate()] = i;
+	return ret;
+}
+
+/* enumerateNormFactors(unsigned long s, const UTO& utp):
+ * restrictions: s >= utp.size()
+ * this function guarantees that the factors get computed only once for each normalized
+ * type
+ * returns: vector with the normalizing factors (see Flag::normFactor) of the flags of
+ *          enumerateFlags(s, utp, f) (in the same order)
+ */
+template<class UTO>
+const std::vector<BigNum::frac>& enumerateNormFactors(unsigned long s, const UTO& utp) {
+	static std::deque< std::deque< std::deque< std::vector<BigNum::frac> > > > mem;
+	std::lock_guard<std::recursive_mutex> lock(memoMutex);
+
+	morphism f;
+	const container< Flag<UTO> >& cont(enumerateFlags<UTO>(s, utp, f));
+	const unsigned long indt(utp.size());
+	const unsigned long inds(s-indt);
+	const unsigned long index(findEnumeratedObject(utp, f));
+
+	if (mem.size() <= indt)
+		mem.resize(indt+1);
+	if (mem[indt].size() <= inds)
+		mem[indt].resize(inds+1);
+	if (mem[indt][inds].size() <= index)
+		mem[indt][inds].resize(enumerateObjects<UTO>(indt).size());
+	std::vector<BigNum::frac>& ret(mem[indt][inds][index]);
+	if (ret.size() != cont.size()) {
+		const BigNum::bignum den(BigNum::decrescentfactorial(s, indt));
+		ret.reserve(cont.size());
+		for (unsigned long i = 0; i < cont.size(); ++i)
+			ret.push_back(BigNum::frac(BigNum::bignum(cont[i].norm.load()), den));
 	}
 	return ret;
 }
@@ -609,15 +790,7 @@ const container< container<coeff_type> >& expandFlagEnumerate(const UTO& utp,
 
 	const container<UTO>& utpEnum(enumerateObjects<UTO>(utp.size()));
 	const unsigned long indTypeSize(utp.size());
-	unsigned long indType = 0;
-	for ( ;
-		  /** This should never happen so it is commented out
-		  indType < utpEnum.size()
-		  **/
-		  ;
-		  ++indType)
-		if (utp.findIsomorphism(utpEnum[indType], f))
-			break;
+	const unsigned long indType(findEnumeratedObject(utp, f));
 	const unsigned long indBase(baseSize - utp.size())
 	const unsigned long indExp(expSize - baseSize);
 
@@ -637,6 +810,90 @@ const container< container<coeff_type> >& expandFlagEnumerate(const UTO& utp,
 #endif
 }
 
+/* countFlagProducts(const container< Flag<UTO> >* contBase1,
+ *                   const container< Flag<UTO> >* contBase2,
+ *                   const container< Flag<UTO> >* contExp,
+ *                   unsigned long diffSize1,
+ *                   unsigned long diffSize2,
+ *                   std::atomic<unsigned long>* next,
+ *                   std::vector< std::vector<prodcount_type> >* counts):
+ * auxiliary function of expandFlagProductEnumerate (run by each of its threads):
+ * while *next is a valid index, takes the k-th flag of contExp (with k the value of
+ * *next, which is incremented) and makes (*counts)[k] hold, in lexicographic order of
+ * (i, j), the nonzero numbers of pairs of disjoint (apart from the type) subflags of it
+ * isomorphic to the i-th flag of contBase1 and to the j-th flag of contBase2
+ * restrictions: diffSize1 and diffSize2 are the numbers of unlabeled vertices of the
+ *               flags of contBase1 and contBase2 respectively
+ * note: the flags are handed out one at a time, so the threads stay balanced even
+ *       when the subflag tests of some flags are much more expensive than others
+ */
+template<class UTO>
+void countFlagProducts(const container< Flag<UTO> >* contBase1,
+					   const container< Flag<UTO> >* contBase2,
+					   const container< Flag<UTO> >* contExp,
+					   unsigned long diffSize1,
+					   unsigned long diffSize2,
+					   std::atomic<unsigned long>* next,
+					   std::vector< std::vector<prodcount_type> >* counts) {
+	std::vector< std::vector<unsigned long> > m
+		(contBase1->size(),
+		 std::vector<unsigned long>(contBase2->size()));
+
+	for (unsigned long k = (*next)++; k < contExp->size(); k = (*next)++) {
+		const Flag<UTO>& expFlag((*contExp)[k]);
+		const vbool& labeledVertices(expFlag.labeledVertices());
+
+		vbool sub1(labeledVertices);
+		Selector::selector<vbool::iterator> sel1(sub1.begin(),
+												 sub1.end(),
+												 sub1.begin(),
+												 sub1.end(),
+												 true);
+
+		for (unsigned long a = 0; a < diffSize1; ++a)
+			sel1[sel1.size()-a-1] = true;
+		do {
+			Flag<UTO> subflag1(expFlag.subflag(sub1));
+			for (unsigned long i = 0;
+				 /** This should never happen so it is commented out
+					 i < contBase1->size()
+				 **/
+				 ;
+				 ++i) {
+				if (subflag1 == (*contBase1)[i]) {
+					vbool sub2(labeledVertices);
+					Selector::selector<vbool::iterator> sel2
+						(sub2.begin(), sub2.end(), sub1.begin(), sub1.end(), true);
+
+					for (unsigned long a = 0; a < diffSize2; ++a)
+						sel2[sel2.size()-a-1] = true;
+					do {
+						Flag<UTO> subflag2(expFlag.subflag(sub2));
+						for (unsigned long j = 0;
+							 /** This should never happen so it is commented out
+								 j < contBase2->size()
+							 **/
+							 ;
+							 ++j) {
+							if (subflag2 == (*contBase2)[j]) {
+								++m[i][j];
+								break;
+							}
+						}
+					} while (std::next_permutation(sel2.begin(), sel2.end()));
+					break;
+				}
+			}
+		} while (std::next_permutation(sel1.begin(), sel1.end()));
+		for (unsigned long i = 0; i < m.size(); ++i)
+			for (unsigned long j = 0; j < m[i].size(); ++j)
+				if (m[i][j]) {
+					(*counts)[k].push_back(prodcount_type(std::make_pair(i, j), m[i][j]));
+					m[i][j] = 0;
+				}
+	}
+}
+
 /* const container< container< container<coeff_type> > >&
  * expandFlagProductEnumerate(const UTO& utp,
  *                            unsigned long base1Size,
@@ -653,6 +910,12 @@ const container< container<coeff_type> >& expandFlagEnumerate(const UTO& utp,
  *          of the expansion of the product between the i-th and j-th flags
  *          (sizes base1Size and base2Size respectively),
  *          where the indexes are in the order of enumeration by enumerateFlags
+ * note: the expansion flags are counted by threadCount threads (see
+ *       countFlagProducts) and the counts are merged in the order of the expansion
+ *       flags, so the result does not depend on the number of threads
+ * note: the threads only take the subflags of the expansion flags, which looks them up
+ *       on enumerateObjectsIndex (safe to read concurrently); the table of this function
+ *       is not locked, so it must not be called by several threads at once
  */
 template<class UTO>
 const container< container< container<coeff_type> > >&
@@ -669,15 +932,7 @@ expandFlagProductEnumerate(const UTO& utp,
 	static std::deque< std::deque< std::deque< std::deque< std::deque< container< container< container<coeff_type> > > > > > > > mem;
 
 	const unsigned long indTypeSize(utp.size());
-	unsigned long indType = 0;
-	for ( ;
-		  /** This should never happen so it is commented out
-		  indType < utpEnum.size()
-		  **/
-		  ;
-		  ++indType)
-		if (utp.findIsomorphism(utpEnum[indType], f))
-			break;
+	const unsigned long indType(findEnumeratedObject(utp, f));
 	const unsigned long indBase1(base1Size - utp.size());
 	const unsigned long indBase2(base2Size - utp.size());
 	const unsigned long indExp(expSize - base1Size  + utp.size() - base2Size);
@@ -706,62 +961,32 @@ expandFlagProductEnumerate(const UTO& utp,
 		BigNum::bignum normfactor(BigNum::binomial(diffSizeExp, diffSize1)
 								  * BigNum::binomial(diffSizeExp - diffSize1, diffSize2));
 
-		for (unsigned long k = 0; k < contExp.size(); ++k) {
-			const Flag<UTO>& expFlag(contExp[k]);
-			const vbool& labeledVertices(expFlag.labeledVertices());
-			std::vector< std::vector<unsigned long> > m
-				(contBase1.size(),
-				 std::vector<unsigned long>(contBase2.size()));
-
-			vbool sub1(labeledVertices);
-			Selector::selector<vbool::iterator> sel1(sub1.begin(),
-													 sub1.end(),
-													 sub1.begin(),
-													 sub1.end(),
-													 true);
-
-			for (unsigned long a = 0; a < diffSize1; ++a)
-				sel1[sel1.size()-a-1] = true;
-			do {
-				Flag<UTO> subflag1(expFlag.subflag(sub1));
-				for (unsigned long i = 0;
-					 /** This should never happen so it is commented out
-						 i < contBase1.size()
-					 **/
-					 ;
-					 ++i) {
-					if (subflag1 == contBase1[i]) {
-						vbool sub2(labeledVertices);
-						Selector::selector<vbool::iterator> sel2
-							(sub2.begin(), sub2.end(), sub1.begin(), sub1.end(), true);
-
-						for (unsigned long a = 0; a < diffSize2; ++a)
-							sel2[sel2.size()-a-1] = true;
-						do {
-							Flag<UTO> subflag2(expFlag.subflag(sub2));
-							for (unsigned long j = 0;
-								 /** This should never happen so it is commented out
-									 j < contBase2.size()
-								 **/
-								 ;
-								 ++j) {
-								if (subflag2 == contBase2[j]) {
-									++m[i][j];
-									break;
-								}
-							}
-						} while (std::next_permutation(sel2.begin(), sel2.end()));
-						break;
-					}
-				}
-			} while (std::next_permutation(sel1.begin(), sel1.end()));
-			for (unsigned long i = 0; i < ret.size(); ++i)
-				for (unsigned long j = 0; j < ret[i].size(); ++j)
-					if (m[i][j])
-						ret[i][j]
-							.push_back(coeff_type(k,
-												  BigNum::frac(BigNum::bignum(m[i][j]),
-															   normfactor)));
+		// The enumerations used by subflag are built before the threads start, so the
+		// threads only read them without locking
+		enumerateObjectsIndex<UTO>(base1Size);
+		enumerateObjectsIndex<UTO>(base2Size);
+
+		std::vector< std::vector<prodcount_type> > counts(contExp.size());
+		std::atomic<unsigned long> next(0);
+		const unsigned long threads(threadCount(contExp.size()));
+		std::vector<std::thread> pool;
+		for (unsigned long t = 1; t < threads; ++t)
+			pool.push_back(std::thread(countFlagProducts<UTO>, &contBase1, &contBase2, &contExp,
+									   diffSize1, diffSize2, &next, &counts));
+		countFlagProducts<UTO>(&contBase1, &contBase2, &contExp,
+							   diffSize1, diffSize2, &next, &counts);
+		for (unsigned long t = 0; t < pool.size(); ++t)
+			pool[t].join();
+
+		for (unsigned long k = 0; k < counts.size(); ++k) {
+			for (unsigned long c = 0; c < counts[k].size(); ++c) {
+				const unsigned long i(counts[k][c].first.first);
+				const unsigned long j(counts[k][c].first.second);
+				ret[i][j].push_back(coeff_type(k,
+											   BigNum::frac(BigNum::bignum(counts[k][c].second),
+															normfactor)));
+			}
+			std::vector<prodcount_type>().swap(counts[k]);
 		}
 	}
 	return ret;
@@ -912,7 +1137,7 @@ container<BigNum::bignum> fprintSDPproblem(FILE* file,
 				fprintf(file, "0 ");
 				continue;
 			}
-			BigNum::frac coeff(0);
+			BigNum::fracSum coeff;
 			for (unsigned long i = 0; i < countObjsCoeffs.size(); ++i) {
 				unsigned long& ind(indexes[i]);
 				const unsigned long countObjInd(countObjsCoeffs[i].first);
@@ -922,14 +1147,14 @@ container<BigNum::bignum> fprintSDPproblem(FILE* file,
 				}
 				if (ind < expandCoeffs[countObjInd].size()
 					&& expandCoeffs[countObjInd][ind].first == j) {
-					coeff += countObjsCoeffs[i].second
-						* expandCoeffs[countObjInd][ind].second;
+					coeff.addmul(countObjsCoeffs[i].second,
+								 expandCoeffs[countObjInd][ind].second);
 				}
 			}
 			fprintf(file,
 					"%s%s ",
 					sgnStr,
-					(coeff * BigNum::frac(scale)).toStringPoint(fracPrecision).c_str());
+					(coeff.value() * BigNum::frac(scale)).toStringPoint(fracPrecision).c_str());
 		}
 		fprintf(file, "\n");
 	}
@@ -955,6 +1180,8 @@ container<BigNum::bignum> fprintSDPproblem(FILE* file,
 
 			const container< Flag<UTO> >& expFlagEnum
 				(enumerateFlags(expSize, utypes[b], f));
+			const std::vector<BigNum::frac>& normFactors
+				(enumerateNormFactors(expSize, utypes[b]));
 
 			unsigned long indi = 0;
 			for (unsigned long i = 0; i < fSel.size(); ++i) {
@@ -969,8 +1196,7 @@ container<BigNum::bignum> fprintSDPproblem(FILE* file,
 							for (unsigned long k = 0; k < expProdEnum.size(); ++k) {
 								const unsigned long ind(expProdEnum[k].first);
 								const BigNum::frac& value(expProdEnum[k].second
-														  * expFlagEnum[ind]
-														  .normFactor());
+														  * normFactors[ind]);
 								// Entry value
 								if (!value.zero()
 									&& allowed[expFlagEnum[ind].objectIndex()]) {
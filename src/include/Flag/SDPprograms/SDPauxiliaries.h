@@ -18,6 +18,12 @@ namespace FlagAlgebra {
 		}
 	};
 
+	// This is an auxiliary function that makes l the lcm of l and d
+	inline void lcmUpdate(BigNum::bignum& l, const BigNum::bignum& d) {
+		if (!(l % d).zero())
+			l = BigNum::lcm(l, d);
+	}
+
 	// This is an auxiliary class to be used in SDProunderProgram(int, char**)
 	class MRef {
 	public:
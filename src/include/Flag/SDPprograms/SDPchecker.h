@@ -5,14 +5,32 @@
 #include "SDPauxiliaries.h"
 #include "Determinant.h"
 #include "getoptions.h"
+#include "Modular.h"
 
 #include <iostream>
 #include <sstream>
 #include <cstdio>
 #include <string>
 #include <cstring>
+#include <cmath>
+#include <vector>
+#include <map>
+#include <unordered_map>
 
 namespace FlagAlgebra {
+	template<class UTO>
+	bool modularFinalCoeffs(bool,
+							const vbool&,
+							const container<BigNum::frac>&,
+							const container< Flag<UTO> >&,
+							const container< container< Flag<UTO> > >&,
+							const container<unsigned long>&,
+							const container<BigNum::bignum>&,
+							unsigned long,
+							const std::vector< std::vector< std::vector<BigNum::frac> > >&,
+							const std::vector< std::vector<BigNum::frac> >*,
+							container<BigNum::frac>&);
+
 	template<class UTO>
 	int SDPcheckerProgram(int, char**);
 
@@ -1,6 +1,357 @@
 #ifndef SDPCHECKERTEMPLATES_CPP_INCLUDED
 #define SDPCHECKERTEMPLATES_CPP_INCLUDED
 
+/* Largest number of residues modularFinalCoeffs keeps at the same time (2^27 residues take
+ * 512MB): beyond it the coefficients are computed with frac arithmetic
+ */
+const unsigned long maxModularResidues = 1UL << 27;
+
+/* class fracSlots numbers the distinct fracs it is given (slots), in the order they are
+ * first seen
+ * note: the fracs are hashed by the residues of their numerators and denominators, so a
+ *       lookup costs one comparison in the expected case
+ */
+class fracSlots {
+public:
+	static const unsigned noSlot = ~0U;
+
+	/* slot(const BigNum::frac& f, bool& added):
+	 * returns: the slot of f (added is made true iff f was not seen before)
+	 */
+	unsigned slot(const BigNum::frac& f, bool& added) {
+		std::unordered_map<BigNum::frac, unsigned, fracHash>::const_iterator it(index.find(f));
+		added = it == index.end();
+		if (!added)
+			return it->second;
+		const unsigned s(static_cast<unsigned>(values.size()));
+		index.insert(std::make_pair(f, s));
+		values.push_back(f);
+		return s;
+	}
+
+	/* fracs() const:
+	 * returns: the fracs seen, in the order of their slots
+	 */
+	const std::vector<BigNum::frac>& fracs() const {
+		return values;
+	}
+
+private:
+	struct fracHash {
+		std::size_t operator()(const BigNum::frac& f) const {
+			return f.numerator().residue(0x7fffffffUL) * 0x9e3779b9UL
+				+ f.denominator().residue(0x7fffffffUL);
+		}
+	};
+
+	std::unordered_map<BigNum::frac, unsigned, fracHash> index;
+	std::vector<BigNum::frac> values;
+};
+
+/* modularFinalCoeffs(bool min,
+ *                    const vbool& allowed,
+ *                    const container<BigNum::frac>& countCoeffs,
+ *                    const container< Flag<UTO> >& types,
+ *                    const container< container< Flag<UTO> > >& flags,
+ *                    const container<unsigned long>& flagSizes,
+ *                    const container<BigNum::bignum>& rescalingFactors,
+ *                    unsigned long expSize,
+ *                    const std::vector< std::vector< std::vector<BigNum::frac> > >& M,
+ *                    const std::vector< std::vector<BigNum::frac> >* EVals,
+ *                    container<BigNum::frac>& finalCoeffs):
+ * restrictions: the arguments are the ones read (and computed) by SDPcheckerProgram,
+ *               EVals is 0 for solutions in matrix format
+ * computes on finalCoeffs the coefficients of the final expansion of the solution
+ * (countCoeffs has the part of the coefficients that comes from the counted UTOs)
+ * The sums are done modulo a set of primes below 2^31. The coefficients are recovered
+ * by rational reconstruction from all primes but the last, whose product exceeds the
+ * bounds: the denominators are bounded by the product of the lcms of the denominators
+ * of each kind of factor of the terms and the numerators by a floating point estimate
+ * of the sum of the absolute values of the terms. Since the estimate is not a proven
+ * bound, every recovered coefficient is checked against its residue modulo the last
+ * prime.
+ * returns: false, iff some coefficient could not be recovered or failed the check, or
+ *          the bounds need too many primes (see maxModularResidues), in which case
+ *          finalCoeffs is unspecified and the coefficients must be computed with frac
+ *          arithmetic
+ * note: the primes are independent of each other, so the innermost operations are done
+ *       over all primes at once on flat arrays of residues
+ */
+template<class UTO>
+bool modularFinalCoeffs(bool min,
+						const vbool& allowed,
+						const container<BigNum::frac>& countCoeffs,
+						const container< Flag<UTO> >& types,
+						const container< container< Flag<UTO> > >& flags,
+						const container<unsigned long>& flagSizes,
+						const container<BigNum::bignum>& rescalingFactors,
+						unsigned long expSize,
+						const std::vector< std::vector< std::vector<BigNum::frac> > >& M,
+						const std::vector< std::vector<BigNum::frac> >* EVals,
+						container<BigNum::frac>& finalCoeffs) {
+	using namespace std;
+	typedef Modular::residue_t residue_t;
+
+	// Computing flag indexes, expansion enumerators and product enumerators
+	vector< vector<unsigned long> > indv(M.size());
+	vector< const container< container< container<coeff_type> > >* > enumProd(M.size());
+	vector< const container< Flag<UTO> >* > expFlagEnum(M.size());
+	vector< const vector<BigNum::frac>* > normFactors(M.size());
+	for (unsigned long b = 0; b < M.size(); ++b) {
+		container< Flag<UTO> > enumFlag(enumerateFlags(flagSizes[b], types[b]));
+		indv[b].assign(flags[b].size(), 0);
+		for (unsigned long i = 0; i < indv[b].size(); ++i) {
+			for ( ;
+				  /** The below shouldn't be needed, so it is commented out
+					  indv[b][i] < enumFlag.size()
+				  **/
+				  ;
+				  ++indv[b][i])
+				if (flags[b][i] == enumFlag[indv[b][i]])
+					break;
+		}
+		morphism g;
+		enumProd[b] = &expandFlagProductEnumerate(types[b].object(),
+												  flagSizes[b],
+												  flagSizes[b],
+												  expSize,
+												  g);
+		expFlagEnum[b] = &enumerateFlags(expSize, types[b].object(), g);
+		normFactors[b] = &enumerateNormFactors(expSize, types[b].object());
+	}
+
+	// Bounds (and the distinct factors of the terms)
+	BigNum::bignum countLcm(BigNum::bn1), entryLcm(BigNum::bn1), evalLcm(BigNum::bn1),
+		coeffLcm(BigNum::bn1), normLcm(BigNum::bn1);
+	double countBound = 0, termsBound = 0;
+	const unsigned noSlot(fracSlots::noSlot);
+	fracSlots coeffs, norms;
+	vector<double> coeffAbs, normAbs;
+	// Entries of the matrices that are not zero
+	vector<vbool> nonZero(M.size());
+	// coeffSlots[b][i*n + j][k] is the slot of the coefficient of the k-th term of the
+	// expansion of the (i,j) entry of block b (noSlot if its object is not allowed)
+	vector< vector< vector<unsigned> > > coeffSlots(M.size());
+	// normSlots[b][f] is the slot of the norm of the f-th expansion flag of block b
+	// (noSlot if no term of the flag is summed)
+	vector< vector<unsigned> > normSlots(M.size());
+	// Largest size of a block and number of expansion flags of a block
+	unsigned long maxBlockSize = 0, maxExpFlags = 0;
+
+	for (unsigned long i = 0; i < countCoeffs.size(); ++i) {
+		if (allowed[i] && !countCoeffs[i].zero()) {
+			lcmUpdate(countLcm, countCoeffs[i].denominator());
+			countBound = max(countBound, fabs(BigNum::fracToDouble(countCoeffs[i])));
+		}
+	}
+
+	for (unsigned long b = 0; b < M.size(); ++b) {
+		const unsigned long n(M[b].size());
+		maxBlockSize = max(maxBlockSize, n);
+		maxExpFlags = max(maxExpFlags, static_cast<unsigned long>(expFlagEnum[b]->size()));
+		normSlots[b].assign(expFlagEnum[b]->size(), noSlot);
+		const double rescaling(BigNum::bignumToDouble(rescalingFactors[b]));
+
+		// Absolute values of the entries (or bounds on them in squares format)
+		vector<double> entryAbs(n * n);
+		nonZero[b].assign(n * n, false);
+		if (EVals) {
+			vector<double> MAbs(n * n), EAbs(n);
+			for (unsigned long i = 0; i < n; ++i) {
+				lcmUpdate(evalLcm, (*EVals)[b][i].denominator());
+				EAbs[i] = fabs(BigNum::fracToDouble((*EVals)[b][i]));
+				for (unsigned long j = 0; j < n; ++j) {
+					lcmUpdate(entryLcm, M[b][i][j].denominator());
+					MAbs[i*n + j] = fabs(BigNum::fracToDouble(M[b][i][j]));
+				}
+			}
+			for (unsigned long i = 0; i < n; ++i) {
+				if ((*EVals)[b][i].zero())
+					continue;
+				for (unsigned long j1 = 0; j1 < n; ++j1) {
+					if (M[b][i][j1].zero())
+						continue;
+					for (unsigned long j2 = 0; j2 < n; ++j2) {
+						if (M[b][i][j2].zero())
+							continue;
+						entryAbs[j1*n + j2] += EAbs[i] * MAbs[i*n + j1] * MAbs[i*n + j2];
+						nonZero[b][j1*n + j2] = true;
+					}
+				}
+			}
+		}
+		else {
+			for (unsigned long i = 0; i < n; ++i) {
+				for (unsigned long j = 0; j < n; ++j) {
+					lcmUpdate(entryLcm, M[b][i][j].denominator());
+					entryAbs[i*n + j] = fabs(BigNum::fracToDouble(M[b][i][j]));
+					nonZero[b][i*n + j] = !M[b][i][j].zero();
+				}
+			}
+		}
+
+		coeffSlots[b].resize(n * n);
+		for (unsigned long i = 0; i < n; ++i) {
+			for (unsigned long j = 0; j < n; ++j) {
+				const container<coeff_type>& expanded((*enumProd[b])[indv[b][i]][indv[b][j]]);
+				if (!nonZero[b][i*n + j])
+					continue;
+				vector<unsigned>& slots(coeffSlots[b][i*n + j]);
+				slots.assign(expanded.size(), noSlot);
+				double sum = 0;
+				for (unsigned long k = 0; k < expanded.size(); ++k) {
+					const unsigned long flagIndex(expanded[k].first);
+					const Flag<UTO>& expFlag((*expFlagEnum[b])[flagIndex]);
+					if (!allowed[expFlag.objectIndex()])
+						continue;
+					bool added;
+					slots[k] = coeffs.slot(expanded[k].second, added);
+					if (added) {
+						coeffAbs.push_back(fabs(BigNum::fracToDouble(expanded[k].second)));
+						lcmUpdate(coeffLcm, expanded[k].second.denominator());
+					}
+					unsigned& normSlot(normSlots[b][flagIndex]);
+					if (normSlot == noSlot) {
+						const BigNum::frac& norm((*normFactors[b])[flagIndex]);
+						normSlot = norms.slot(norm, added);
+						if (added) {
+							normAbs.push_back(fabs(BigNum::fracToDouble(norm)));
+							lcmUpdate(normLcm, norm.denominator());
+						}
+					}
+					sum += coeffAbs[slots[k]] * normAbs[normSlot];
+				}
+				termsBound += entryAbs[i*n + j] * rescaling * sum;
+			}
+		}
+	}
+
+	// The relative margin only covers the floating point errors of sums with fewer than
+	// 10^9 terms, so the results are checked modulo an extra prime
+	const double bound(ceil((countBound + termsBound) * (1 + 1e-6) + 1));
+	if (!(bound < 1e300))
+		return false;
+	BigNum::bignum denBound(countLcm * entryLcm * evalLcm * coeffLcm * normLcm);
+	if (EVals)
+		denBound *= entryLcm;
+	const BigNum::bignum numBound(BigNum::doubleToFrac(bound).numerator() * denBound);
+
+	Modular::primeSet primes;
+	while (primes.product() <= numBound * denBound * BigNum::bn2)
+		primes.addPrime();
+	// Primes used for the reconstruction (the last one is only used for the check)
+	const unsigned long nr(primes.size());
+	primes.addPrime();
+	const unsigned long np(primes.size());
+	cerr << "Using " << np << " primes.\n";
+
+	// The residue vectors kept at the same time (this is where the memory goes when the
+	// bounds need many primes, in which case frac arithmetic is better anyway)
+	const unsigned long vectors(countCoeffs.size() + 2 * coeffs.fracs().size()
+								+ norms.fracs().size() + maxBlockSize * maxBlockSize
+								+ maxExpFlags);
+	if (vectors * np > maxModularResidues) {
+		cerr << "Too many primes for multi-modular arithmetic.\n";
+		return false;
+	}
+
+	// Residues of the factors
+	vector<residue_t> coeffRes(coeffs.fracs().size() * np);
+	for (unsigned long i = 0; i < coeffs.fracs().size(); ++i)
+		if (!primes.fromFrac(coeffs.fracs()[i], &coeffRes[i*np]))
+			return false;
+	vector<residue_t> normRes(norms.fracs().size() * np);
+	for (unsigned long i = 0; i < norms.fracs().size(); ++i)
+		if (!primes.fromFrac(norms.fracs()[i], &normRes[i*np]))
+			return false;
+
+	vector<residue_t> acc(countCoeffs.size() * np);
+	for (unsigned long i = 0; i < countCoeffs.size(); ++i)
+		if (allowed[i] && !primes.fromFrac(countCoeffs[i], &acc[i*np]))
+			return false;
+
+	/* The terms are summed per expansion flag (on flagSums) and each sum is multiplied by
+	 * the norm of its flag only once, afterwards
+	 * For each (i,j) entry, the product of the entry by a coefficient is computed the
+	 * first time the coefficient is seen (products[s] is valid iff stamps[s] == i*n + j),
+	 * so that each term only takes one addition
+	 */
+	vector<residue_t> rescaling(np), entry(np), factor(np);
+	vector<residue_t> products(coeffs.fracs().size() * np), flagSums;
+	vector<unsigned long> stamps;
+	for (unsigned long b = 0; b < M.size(); ++b) {
+		const unsigned long n(M[b].size());
+		primes.fromBignum(rescalingFactors[b], &rescaling[0]);
+
+		vector<residue_t> MRes(n * n * np), ERes;
+		for (unsigned long i = 0; i < n; ++i)
+			for (unsigned long j = 0; j < n; ++j)
+				if (!primes.fromFrac(M[b][i][j], &MRes[(i*n + j)*np]))
+					return false;
+		if (EVals) {
+			ERes.resize(n * np);
+			for (unsigned long i = 0; i < n; ++i)
+				if (!primes.fromFrac((*EVals)[b][i], &ERes[i*np]))
+					return false;
+		}
+
+		flagSums.assign(expFlagEnum[b]->size() * np, 0);
+		stamps.assign(coeffs.fracs().size(), n * n);
+		for (unsigned long i = 0; i < n; ++i) {
+			for (unsigned long j = 0; j < n; ++j) {
+				const container<coeff_type>& expanded((*enumProd[b])[indv[b][i]][indv[b][j]]);
+				if (expanded.empty() || !nonZero[b][i*n + j])
+					continue;
+				if (EVals) {
+					// The (i,j) entry of the matrix is the same for every flag of the
+					// expansion, so it is computed only once
+					fill(entry.begin(), entry.end(), 0);
+					for (unsigned long l = 0; l < n; ++l) {
+						primes.multiply(&factor[0], &ERes[l*np], &MRes[(l*n + i)*np]);
+						primes.addmul(&entry[0], &factor[0], &MRes[(l*n + j)*np]);
+					}
+				}
+				else
+					copy(&MRes[(i*n + j)*np], &MRes[(i*n + j)*np] + np, entry.begin());
+				if (primes.zero(&entry[0]))
+					continue;
+				primes.multiply(&entry[0], &entry[0], &rescaling[0]);
+
+				const vector<unsigned>& slots(coeffSlots[b][i*n + j]);
+				for (unsigned long k = 0; k < expanded.size(); ++k) {
+					const unsigned s(slots[k]);
+					if (s == noSlot)
+						continue;
+					if (stamps[s] != i*n + j) {
+						primes.multiply(&products[s*np], &entry[0], &coeffRes[s*np]);
+						stamps[s] = i*n + j;
+					}
+					primes.add(&flagSums[expanded[k].first * np], &products[s*np]);
+				}
+			}
+		}
+
+		for (unsigned long f = 0; f < normSlots[b].size(); ++f) {
+			if (normSlots[b][f] == noSlot)
+				continue;
+			residue_t *a(&acc[(*expFlagEnum[b])[f].objectIndex() * np]);
+			if (min)
+				primes.submul(a, &flagSums[f*np], &normRes[normSlots[b][f] * np]);
+			else
+				primes.addmul(a, &flagSums[f*np], &normRes[normSlots[b][f] * np]);
+		}
+	}
+
+	cerr << "Reconstructing coefficients.\n";
+	finalCoeffs.assign(countCoeffs.size(), BigNum::frac());
+	for (unsigned long i = 0; i < countCoeffs.size(); ++i)
+		if (allowed[i]
+			&& (!primes.reconstruct(&acc[i*np], numBound, denBound, finalCoeffs[i], nr)
+				|| !primes.agrees(&acc[i*np], finalCoeffs[i])))
+			return false;
+	return true;
+}
+
 /* SDPcheckerProgram(int argc, char **argv):
  * This program reads a solution written in the standard of SDPsolverProgram
  * and checks its validity
@@ -10,17 +361,28 @@ int SDPcheckerProgram(int argc, char **argv) {
 	using namespace std;
 
 	bool printCoeffsMode = false;
+	bool modularMode = false;
 
 	/* Options parsing block */ {
 		int ind1 = 1, ind2 = 0;
 		char opt;
 		const char* arg = "";
 		while (true) {
-			if (Text::getoptions("c", ind1, ind2, opt, arg, argc, argv)) {
+			if (Text::getoptions("cmt:", ind1, ind2, opt, arg, argc, argv)) {
 				switch (opt) {
 				case 'c':
 					printCoeffsMode = true;
 					break;
+				case 'm':
+					modularMode = true;
+					break;
+				case 't':
+					stringstream(arg) >> maxThreads;
+					break;
+				case ':':
+					cerr << "Missing argument for option: " << *arg
+						 << "\nTry `" << argv[0] << " --help' for more information.\n";
+					return 1;
 				case '\0':
 					cerr << "Invalid option: " << *arg
 						 << "\nTry `" << argv[0] << " --help' for more information.\n";
@@ -28,10 +390,15 @@ int SDPcheckerProgram(int argc, char **argv) {
 				}
 			}
 			else if (ind1 < argc && !strcmp(argv[ind1] + ind2, "--help")) {
-				cerr << "Usage: " << argv[0] << " [-c]\n"
+				cerr << "Usage: " << argv[0] << " [-c] [-m] [-t N]\n"
 					 << "Run flag algebra SDP solution checker.\n\n"
 					 << "  -c  print objects and coefficients of final expansion\n"
 					 << "      aftwerwards\n"
+					 << "  -m  compute final expansion modulo word-size primes and\n"
+					 << "      recover it by rational reconstruction (falls back to\n"
+					 << "      exact arithmetic if this fails)\n"
+					 << "  -t N  use at most N threads to build the product tables\n"
+					 << "        (N = 0, the default, means one per hardware thread)\n"
 					 << "\n";
 				return 0;
 			}
@@ -175,7 +542,11 @@ int SDPcheckerProgram(int argc, char **argv) {
 				allowed[expEnum[objIndex][j].first] = false;
 		}
 
-		container<BigNum::frac> finalCoeffs(finalUTOsEnum.size());
+		// The coefficients are accumulated over common denominators and only reduced
+		// once, after every term was added
+		container<BigNum::fracSum> finalSums(finalUTOsEnum.size());
+		container<BigNum::frac> finalCoeffs;
+		bool modularDone = false;
 		cerr << "Computing counted UTOs expansion coefficients.\n";
 		for (unsigned long i = 0; i < countUTOs.size(); ++i) {
 			const container< container<coeff_type> >& expEnum
@@ -193,7 +564,7 @@ int SDPcheckerProgram(int argc, char **argv) {
 					break;
 			for (unsigned long j = 0; j < expEnum[objIndex].size(); ++j)
 				if (allowed[expEnum[objIndex][j].first])
-					finalCoeffs[expEnum[objIndex][j].first]
+					finalSums[expEnum[objIndex][j].first]
 						+= expEnum[objIndex][j].second;
 		}
 
@@ -233,8 +604,21 @@ int SDPcheckerProgram(int argc, char **argv) {
 			if (isPSD)
 				cout << "Matrix is positive semidefinite.\n";
 
-			cerr << "Computing final value.\n\n";
-			for (unsigned long b = 0; b < M.size(); ++b) {
+			if (modularMode) {
+				cerr << "Computing final value by multi-modular arithmetic.\n";
+				container<BigNum::frac> countCoeffs;
+				for (unsigned long i = 0; i < finalSums.size(); ++i)
+					countCoeffs.push_back(finalSums[i].value());
+				modularDone = modularFinalCoeffs(min, allowed, countCoeffs, types, flags,
+												 flagSizes, rescalingFactors, expSize,
+												 M, 0, finalCoeffs);
+				if (!modularDone)
+					cerr << "Multi-modular arithmetic failed.\n";
+			}
+
+			if (!modularDone)
+				cerr << "Computing final value.\n\n";
+			for (unsigned long b = 0; !modularDone && b < M.size(); ++b) {
 
 				container< Flag<UTO> > enumFlag(enumerateFlags(flagSizes[b], types[b]));
 				vector<unsigned long> indv(flags[b].size());
@@ -259,24 +643,26 @@ int SDPcheckerProgram(int argc, char **argv) {
 												g));
 				const container< Flag<UTO> >& expFlagEnum
 					(enumerateFlags(expSize, types[b].object(), g));
+				const vector<BigNum::frac>& normFactors
+					(enumerateNormFactors(expSize, types[b].object()));
+				const BigNum::frac rescaling(rescalingFactors[b]);
 				for (unsigned long i = 0; i < M[b].size(); ++i) {
 					for (unsigned long j = 0; j < M[b][i].size(); ++j) {
 						const container<coeff_type>& expanded(enumProd[indv[i]][indv[j]]);
+						if (expanded.empty() || M[b][i][j].zero())
+							continue;
+						const BigNum::frac entry(M[b][i][j] * rescaling);
 						for (unsigned long k = 0; k < expanded.size(); ++k) {
 							const Flag<UTO>& expFlag(expFlagEnum[expanded[k].first]);
 							if (allowed[expFlag.objectIndex()]) {
 								if (min)
-									finalCoeffs[expFlag.objectIndex()]
-										-= M[b][i][j]
-										* expanded[k].second
-										* expFlag.normFactor()
-										* BigNum::frac(rescalingFactors[b]);
+									finalSums[expFlag.objectIndex()]
+										.submul(entry * expanded[k].second,
+												normFactors[expanded[k].first]);
 								else
-									finalCoeffs[expFlag.objectIndex()]
-										+= M[b][i][j]
-										* expanded[k].second
-										* expFlag.normFactor()
-										* BigNum::frac(rescalingFactors[b]);
+									finalSums[expFlag.objectIndex()]
+										.addmul(entry * expanded[k].second,
+												normFactors[expanded[k].first]);
 							}
 						}
 					}
@@ -335,9 +721,21 @@ int SDPcheckerProgram(int argc, char **argv) {
 			if (isPSD)
 				cout << "Matrix is positive semidefinite.\n";
 
+			if (modularMode) {
+				cerr << "Computing final value by multi-modular arithmetic.\n";
+				container<BigNum::frac> countCoeffs;
+				for (unsigned long i = 0; i < finalSums.size(); ++i)
+					countCoeffs.push_back(finalSums[i].value());
+				modularDone = modularFinalCoeffs(min, allowed, countCoeffs, types, flags,
+												 flagSizes, rescalingFactors, expSize,
+												 M, &EVals, finalCoeffs);
+				if (!modularDone)
+					cerr << "Multi-modular arithmetic failed.\n";
+			}
 
-			cerr << "Computing final value.\n\n";
-			for (unsigned long b = 0; b < M.size(); ++b) {
+			if (!modularDone)
+				cerr << "Computing final value.\n\n";
+			for (unsigned long b = 0; !modularDone && b < M.size(); ++b) {
 				morphism g;
 
 				container< Flag<UTO> > enumFlag(enumerateFlags(flagSizes[b], types[b]));
@@ -362,31 +760,34 @@ int SDPcheckerProgram(int argc, char **argv) {
 												g));
 				const container< Flag<UTO> >& expFlagEnum
 					(enumerateFlags(expSize, types[b].object(), g));
+				const vector<BigNum::frac>& normFactors
+					(enumerateNormFactors(expSize, types[b].object()));
+				const BigNum::frac rescaling(rescalingFactors[b]);
 				for (unsigned long j1 = 0; j1 < flagsUsed[b]; ++j1) {
 					for (unsigned long j2 = 0; j2 < flagsUsed[b]; ++j2) {
 						const container<coeff_type>& expanded
 							(enumProd[indv[j1]][indv[j2]]);
+						if (expanded.empty())
+							continue;
+						// The (j1,j2) entry of the matrix is the same for every flag of
+						// the expansion, so it is computed only once
+						BigNum::frac entry;
+						for (unsigned long i = 0; i < M[b].size(); ++i)
+							entry.addmul(EVals[b][i] * M[b][i][j1], M[b][i][j2]);
+						if (entry.zero())
+							continue;
+						entry *= rescaling;
 						for (unsigned long k = 0; k < expanded.size(); ++k) {
 							const Flag<UTO>& expFlag(expFlagEnum[expanded[k].first]);
 							if (allowed[expFlag.objectIndex()]) {
-								for (unsigned long i = 0; i < M[b].size(); ++i) {
-									if (min)
-										finalCoeffs[expFlag.objectIndex()]
-											-= EVals[b][i]
-											* M[b][i][j1]
-											* M[b][i][j2]
-											* expanded[k].second
-											* expFlag.normFactor()
-											* BigNum::frac(rescalingFactors[b]);
-									else
-										finalCoeffs[expFlag.objectIndex()]
-											+= EVals[b][i]
-											* M[b][i][j1]
-											* M[b][i][j2]
-											* expanded[k].second
-											* expFlag.normFactor()
-											* BigNum::frac(rescalingFactors[b]);
-								}
+								if (min)
+									finalSums[expFlag.objectIndex()]
+										.submul(entry * expanded[k].second,
+												normFactors[expanded[k].first]);
+								else
+									finalSums[expFlag.objectIndex()]
+										.addmul(entry * expanded[k].second,
+												normFactors[expanded[k].first]);
 							}
 						}
 					}
@@ -394,6 +795,14 @@ int SDPcheckerProgram(int argc, char **argv) {
 			}
 		}
 
+		if (!modularDone) {
+			// modularFinalCoeffs may have left a partial result
+			finalCoeffs.clear();
+			for (unsigned long i = 0; i < finalSums.size(); ++i)
+				finalCoeffs.push_back(finalSums[i].value());
+		}
+		finalSums.clear();
+
 		// Calculating minimum or maximum coefficient (depending on min)
 		unsigned long valueIndex = 0;
 		for (valueIndex = 0; valueIndex < finalCoeffs.size(); ++valueIndex)
@@ -21,7 +21,7 @@ int SDPgenerateProgram(int argc, char **argv) {
 		char opt;
 		const char* arg = "";
 		while (true) {
-			if (Text::getoptions("pr:s:", ind1, ind2, opt, arg, argc, argv)) {
+			if (Text::getoptions("pr:s:t:", ind1, ind2, opt, arg, argc, argv)) {
 				stringstream ss(arg);
 				unsigned long auxUL = 0;
 				switch (opt) {
@@ -41,6 +41,9 @@ int SDPgenerateProgram(int argc, char **argv) {
 					}
 					solverUsed = static_cast<Solvers>(auxUL);
 					break;
+				case 't':
+					ss >> maxThreads;
+					break;
 				case ':':
 					cerr << "Missing argument for option: " << *arg
 						 << "\nTry `" << argv[0] << " --help' for more information.\n";
@@ -67,6 +70,10 @@ int SDPgenerateProgram(int argc, char **argv) {
 					 << "  -s N  run solver number N in generated problem and generate\n"
 					 << "          solution files from solvers solution.\n"
 					 << SolversHelp
+					 << "  -tN\n"
+					 << "  -t N  use at most N threads to build the product tables.\n"
+					 << "          N = 0 means one thread per hardware thread;\n"
+					 << "          without -t N option, the program uses N = 0.\n"
 					 << "\n";
 				return 0;
 			}
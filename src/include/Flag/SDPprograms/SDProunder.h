@@ -9,6 +9,7 @@
 #include "Monitoring.h"
 
 #include <iostream>
+#include <sstream>
 #include <cstdio>
 #include <string>
 #include <cstring>
@@ -11,17 +11,21 @@ int SDProunderProgram(int argc, char **argv) {
 
 	bool autoMode = false;
 	bool recomputeEigen = false;
+	bool commonDenominator = false;
 
 	/* Options parsing block */ {
 		int ind1 = 1, ind2 = 0;
 		char opt;
 		const char* arg = "";
 		while (true) {
-			if (Text::getoptions("ae", ind1, ind2, opt, arg, argc, argv)) {
+			if (Text::getoptions("adet:", ind1, ind2, opt, arg, argc, argv)) {
 				switch (opt) {
 				case 'a':
 					autoMode = true;
 					break;
+				case 'd':
+					commonDenominator = true;
+					break;
 				case 'e':
 					recomputeEigen = true;
 #ifndef LAPACKE_AVAILABLE
@@ -32,6 +36,13 @@ int SDProunderProgram(int argc, char **argv) {
 					recomputeEigen = false;
 #endif
 						break;
+				case 't':
+					stringstream(arg) >> maxThreads;
+					break;
+				case ':':
+					cerr << "Missing argument for option: " << *arg
+						 << "\nTry `" << argv[0] << " --help' for more information.\n";
+					return 1;
 				case '\0':
 					cerr << "Invalid option: " << *arg
 						 << "\nTry `" << argv[0] << " --help' for more information.\n";
@@ -39,11 +50,15 @@ int SDProunderProgram(int argc, char **argv) {
 				}
 			}
 			else if (ind1 < argc && !strcmp(argv[ind1] + ind2, "--help")) {
-				cerr << "Usage: " << argv[0] << " [-a]\n"
+				cerr << "Usage: " << argv[0] << " [-a] [-d] [-e] [-t N]\n"
 					 << "Run flag algebra SDP solution rounder.\n\n"
 					 << "  -a  run in automatic mode (rounder will make the decisions\n"
 					 << "        on parameter change if it fails to round)\n"
+					 << "  -d  round the entries of each zero-eigenvector to a common\n"
+					 << "        denominator\n"
 					 << "  -e  recompute eigenvalues if solution is in squares format\n"
+					 << "  -t N  use at most N threads to build the product tables\n"
+					 << "        (N = 0, the default, means one per hardware thread)\n"
 					 << "\n";
 				return 0;
 			}
@@ -318,10 +333,8 @@ int SDProunderProgram(int argc, char **argv) {
 				for (unsigned long i = 0; i < EVals[b].size(); ++i) {
 					for (unsigned long j1 = 0; j1 < EVecs[b].size(); ++j1) {
 						for (unsigned long j2 = 0; j2 < EVecs[b].size(); ++j2) {
-							M[b][j1][j2]
-								+= EVals[b][i]
-								* EVecs[b][i][j1]
-								* EVecs[b][i][j2];
+							M[b][j1][j2].addmul(EVals[b][i] * EVecs[b][i][j1],
+												EVecs[b][i][j2]);
 						}
 					}
 				}
@@ -381,7 +394,8 @@ int SDProunderProgram(int argc, char **argv) {
 			}
 		}
 
-		container<BigNum::frac> finalCoeffsApprox(countCoeffs);
+		// Accumulated over common denominators and reduced once below
+		container<BigNum::fracSum> approxSums(countCoeffs.begin(), countCoeffs.end());
 
 		vector< map<unsigned long, BigNum::frac> > restrictions
 			(finalUTOsEnum.size()
@@ -397,6 +411,7 @@ int SDProunderProgram(int argc, char **argv) {
 		container< const container< container< container<coeff_type> > >* > enumProd
 			(M.size());
 		container< const container< Flag<UTO> >* > expFlagEnum(M.size());
+		container< const vector<BigNum::frac>* > normFactors(M.size());
 		for (unsigned long b = 0; b < M.size(); ++b) {
 			// Computing flag indexes
 			container< Flag<UTO> > enumFlag(enumerateFlags(flagSizes[b], types[b]));
@@ -421,10 +436,12 @@ int SDProunderProgram(int argc, char **argv) {
 													  g);
 			// Computing product enumerator
 			expFlagEnum[b] = &enumerateFlags(expSize, types[b].object(), g);
+			normFactors[b] = &enumerateNormFactors(expSize, types[b].object());
 		}
 
 		cerr << "Computing final values.\n\n";
 		for (unsigned long b = 0; b < M.size(); ++b) {
+			const BigNum::frac rescaling(rescalingFactors[b]);
 			for (unsigned long i = 0; i < M[b].size(); ++i) {
 				for (unsigned long j = 0; j < M[b][i].size(); ++j) {
 					const container<coeff_type>& expanded
@@ -433,17 +450,17 @@ int SDProunderProgram(int argc, char **argv) {
 						const Flag<UTO>& expFlag((*expFlagEnum[b])[expanded[k].first]);
 						if (allowed[expFlag.objectIndex()]) {
 							BigNum::frac factor(expanded[k].second
-												* expFlag.normFactor()
-												* BigNum::frac(rescalingFactors[b]));
+												* (*normFactors[b])[expanded[k].first]);
+							factor *= rescaling;
 							if (min) {
-								finalCoeffsApprox[expFlag.objectIndex()]
-									-= M[b][i][j] * factor;
+								approxSums[expFlag.objectIndex()]
+									.submul(M[b][i][j], factor);
 								restrictions[expFlag.objectIndex()][MRefToIndex[b][i][j]]
 									+= factor;
 							}
 							else {
-								finalCoeffsApprox[expFlag.objectIndex()]
-									+= M[b][i][j] * factor;
+								approxSums[expFlag.objectIndex()]
+									.addmul(M[b][i][j], factor);
 								restrictions[expFlag.objectIndex()][MRefToIndex[b][i][j]]
 									-= factor;
 							}
@@ -453,6 +470,11 @@ int SDProunderProgram(int argc, char **argv) {
 			}
 		}
 
+		container<BigNum::frac> finalCoeffsApprox;
+		for (unsigned long i = 0; i < approxSums.size(); ++i)
+			finalCoeffsApprox.push_back(approxSums[i].value());
+		approxSums.clear();
+
 		unsigned long nRoundEigen;
 		BigNum::frac epsilonPos, epsilonConj, epsilonRoundMat,
 			prevEpsilonPos, prevEpsilonConj;
@@ -618,8 +640,8 @@ int SDProunderProgram(int argc, char **argv) {
 							if (oi != i && select[baseInd + oi*flagsUsed[b]]) {
 								for (unsigned long j = 0; j < NormEVecs[oi].size(); ++j)
 									if (j != absMaxInd)
-										NormEVecs[oi][j] -= NormEVecs[i][j]
-											* NormEVecs[oi][absMaxInd];
+										NormEVecs[oi][j].submul(NormEVecs[i][j],
+																NormEVecs[oi][absMaxInd]);
 								NormEVecs[oi][absMaxInd] = BigNum::frac(BigNum::bn0);
 							}
 						}
@@ -630,8 +652,11 @@ int SDProunderProgram(int argc, char **argv) {
 					unsigned long iInd(baseInd + i*flagsUsed[b]);
 					if (select[iInd]) {
 						// Rounding zero-eigenvectors entries
-						for (unsigned long j = 0; j < NormEVecs[i].size(); ++j)
-							NormEVecs[i][j] = NormEVecs[i][j].humanRounded(nRoundEigen);
+						if (commonDenominator)
+							NormEVecs[i] = BigNum::humanRounded(NormEVecs[i], nRoundEigen);
+						else
+							for (unsigned long j = 0; j < NormEVecs[i].size(); ++j)
+								NormEVecs[i][j] = NormEVecs[i][j].humanRounded(nRoundEigen);
 
 						/* Writing zero-eigenvectors restrictions
 						 * Note: this has to be done every iteration since the
@@ -702,10 +727,12 @@ int SDProunderProgram(int argc, char **argv) {
 				}
 				BigNum::frac roundedObtained;
 				/* Conjectured value check */ {
-					container<BigNum::frac> finalCoeffsRounded(countCoeffs);
+					container<BigNum::fracSum> roundedSums(countCoeffs.begin(),
+														   countCoeffs.end());
 
 					for (unsigned long b = 0; b < M.size(); ++b) {
 						morphism g;
+						const BigNum::frac rescaling(rescalingFactors[b]);
 						for (unsigned long i = 0; i < M[b].size(); ++i) {
 							for (unsigned long j = 0; j < M[b][i].size(); ++j) {
 								const container<coeff_type>& expanded
@@ -715,24 +742,29 @@ int SDProunderProgram(int argc, char **argv) {
 										((*expFlagEnum[b])[expanded[k].first]);
 									if (allowed[expFlag.objectIndex()]) {
 										if (min) {
-											finalCoeffsRounded[expFlag.objectIndex()]
-												-= roundedValues[MRefToIndex[b][i][j]]
-												* expanded[k].second
-												* expFlag.normFactor()
-												* BigNum::frac(rescalingFactors[b]);
+											roundedSums[expFlag.objectIndex()]
+												.submul(roundedValues[MRefToIndex[b][i][j]]
+														* expanded[k].second,
+														(*normFactors[b])[expanded[k].first]
+														* rescaling);
 										}
 										else {
-											finalCoeffsRounded[expFlag.objectIndex()]
-												+= roundedValues[MRefToIndex[b][i][j]]
-												* expanded[k].second
-												* expFlag.normFactor()
-												* BigNum::frac(rescalingFactors[b]);
+											roundedSums[expFlag.objectIndex()]
+												.addmul(roundedValues[MRefToIndex[b][i][j]]
+														* expanded[k].second,
+														(*normFactors[b])[expanded[k].first]
+														* rescaling);
 										}
 									}
 								}
 							}
 						}
 					}
+					container<BigNum::frac> finalCoeffsRounded;
+					for (unsigned long i = 0; i < roundedSums.size(); ++i)
+						finalCoeffsRounded.push_back(roundedSums[i].value());
+					roundedSums.clear();
+
 					// Calculating minimum or maximum coefficient (depending on min)
 					unsigned long valueIndex = 0;
 					for (valueIndex = 0;
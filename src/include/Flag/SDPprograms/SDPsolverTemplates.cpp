@@ -28,7 +28,7 @@ int SDPsolverProgram(int argc, char **argv) {
 		char opt;
 		const char* arg = "";
 		while (true) {
-			if (Text::getoptions("pr:s:", ind1, ind2, opt, arg, argc, argv)) {
+			if (Text::getoptions("pr:s:t:", ind1, ind2, opt, arg, argc, argv)) {
 				stringstream ss(arg);
 				unsigned long auxUL = 0;
 				switch (opt) {
@@ -47,6 +47,9 @@ int SDPsolverProgram(int argc, char **argv) {
 					}
 					solverUsed = static_cast<Solvers>(auxUL);
 					break;
+				case 't':
+					ss >> maxThreads;
+					break;
 				case ':':
 					cerr << "Missing argument for option: " << *arg
 						 << "\nTry `" << argv[0] << " --help' for more information.\n";
@@ -73,6 +76,10 @@ int SDPsolverProgram(int argc, char **argv) {
 					 << "  -s N  use solver number N.\n"
 					 << SolversHelp
 					 << "          without -s N option, the program uses N = 0.\n"
+					 << "  -tN\n"
+					 << "  -t N  use at most N threads to build the product tables.\n"
+					 << "          N = 0 means one thread per hardware thread;\n"
+					 << "          without -t N option, the program uses N = 0.\n"
 					 << "\n";
 				return 0;
 			}
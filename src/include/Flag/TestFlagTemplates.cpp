@@ -60,6 +60,42 @@ void testFlag() {
 			cerr << f[i] << " ";
 		cerr << endl << endl;
 
+		morphism lab1, lab2;
+		const Canonical::certificate_t cert1(uto1.certificate(&lab1));
+		const Canonical::certificate_t cert2(uto2.certificate(&lab2));
+		cerr << "certificate() of the first object:\n" << hex;
+		for (unsigned long i = 0; i < cert1.size(); ++i)
+			cerr << cert1[i] << " ";
+		cerr << dec << "\n  canonical labelling returned:\n";
+		for (unsigned long i = 0; i < lab1.size(); ++i)
+			cerr << lab1[i] << " ";
+		cerr << "\ncertificate() of the second object:\n" << hex;
+		for (unsigned long i = 0; i < cert2.size(); ++i)
+			cerr << cert2[i] << " ";
+		cerr << dec << "\n  canonical labelling returned:\n";
+		for (unsigned long i = 0; i < lab2.size(); ++i)
+			cerr << lab2[i] << " ";
+		cerr << "\ncertificates equal: " << (cert1 == cert2) << endl << endl;
+
+		cerr << "canonicalForm() of the first object:\n";
+		fprintobj(stderr, uto1.canonicalForm());
+		cerr << "\ncanonicalForm() of the second object:\n";
+		fprintobj(stderr, uto2.canonicalForm());
+		cerr << endl << endl;
+
+		// The subobject selecting vbool is used as colouring
+		std::vector<unsigned long> colours(sel.begin(), sel.end());
+		morphism lab;
+		const Canonical::certificate_t cert(uto1.certificate(colours, &lab));
+		cerr << "certificate() of the first object coloured by the selecting vbool:\n"
+			 << hex;
+		for (unsigned long i = 0; i < cert.size(); ++i)
+			cerr << cert[i] << " ";
+		cerr << dec << "\n  canonical labelling returned:\n";
+		for (unsigned long i = 0; i < lab.size(); ++i)
+			cerr << lab[i] << " ";
+		cerr << endl << endl;
+
 
 		unsigned long s;
 		cerr << "Type size of enumeration: ";
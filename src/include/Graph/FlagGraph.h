@@ -4,9 +4,13 @@
 #include <vector>
 
 #include "Flag.h"
+#include "bitMatrix.h"
 
 namespace FlagAlgebra {
-	// class Graph represents graphs as UTOs
+	/* class Graph represents graphs as UTOs
+	 * The adjacency matrix is kept with one bitset per row, so degrees are population
+	 * counts and adjacencies are compared a word at a time
+	 */
 	class Graph {
 	public:
 		Graph();
@@ -23,6 +27,11 @@ namespace FlagAlgebra {
 		bool operator==(const Graph&) const;
 		bool operator!=(const Graph&) const;
 
+		Canonical::certificate_t certificate(morphism* = 0) const;
+		Canonical::certificate_t certificate(const std::vector<unsigned long>&,
+											 morphism* = 0) const;
+		Graph canonicalForm() const;
+
 		unsigned long degree(unsigned long) const;
 
 		int readFromFile(FILE*);
@@ -31,7 +40,14 @@ namespace FlagAlgebra {
 		static container<Graph> enumerate(unsigned long);
 	protected:
 		unsigned long s;
-		vbool m;
+		BitMatrix::bitMatrix m;
+
+		bool refineAssignment(const Graph&,
+							  unsigned long,
+							  unsigned long,
+							  unsigned long,
+							  std::vector< std::vector<unsigned long> >&,
+							  std::vector< std::vector<unsigned long> >&) const;
 	};
 }
 
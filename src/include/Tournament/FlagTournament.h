@@ -24,12 +24,22 @@ namespace FlagAlgebra {
 		bool operator==(const Tournament&) const;
 		bool operator!=(const Tournament&) const;
 
+		Canonical::certificate_t certificate(morphism* = 0) const;
+		Canonical::certificate_t certificate(const std::vector<unsigned long>&,
+											 morphism* = 0) const;
+		Tournament canonicalForm() const;
+
 		int readFromFile(FILE*);
 		void writeOnFile(FILE*) const;
 
 		static container<Tournament> enumerate(unsigned long);
 	protected:
 		explicit Tournament(const Digraph&);
+
+		static void augmentParents(const container<Tournament>*,
+								   unsigned long,
+								   unsigned long,
+								   std::vector< mcont<Tournament> >*);
 	};
 }
 
@@ -0,0 +1,43 @@
+#ifndef CANONICAL_H_INCLUDED
+#define CANONICAL_H_INCLUDED
+
+#include "bitMatrix.h"
+
+#include <vector>
+#include <cstddef>
+
+namespace Canonical {
+	/* Type of the certificates: two (vertex coloured) adjacency matrices have equal
+	 * certificates iff there is a colour preserving isomorphism between them
+	 */
+	typedef std::vector<BitMatrix::word_t> certificate_t;
+
+	// Hash of certificates (to be used with the unordered containers)
+	struct certificateHash {
+		std::size_t operator()(const certificate_t&) const;
+	};
+
+	std::vector<unsigned long> refinedColours(const BitMatrix::bitMatrix&,
+											  const BitMatrix::bitMatrix&,
+											  const std::vector<unsigned long>&);
+	bool refinedPair(const BitMatrix::bitMatrix&,
+					 const BitMatrix::bitMatrix&,
+					 const std::vector<unsigned long>&,
+					 const BitMatrix::bitMatrix&,
+					 const BitMatrix::bitMatrix&,
+					 const std::vector<unsigned long>&,
+					 std::vector<unsigned long>&,
+					 std::vector<unsigned long>&);
+	certificate_t canonicalLabelling(const BitMatrix::bitMatrix&,
+									 const BitMatrix::bitMatrix&,
+									 const std::vector<unsigned long>&,
+									 std::vector<unsigned long>&);
+	BitMatrix::bitMatrix relabelled(const BitMatrix::bitMatrix&,
+									const std::vector<unsigned long>&);
+}
+
+/* Local Variables: */
+/* mode: c++ */
+/* tab-width: 4 */
+/* End: */
+#endif
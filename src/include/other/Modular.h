@@ -0,0 +1,66 @@
+#ifndef MODULAR_H_INCLUDED
+#define MODULAR_H_INCLUDED
+
+#include "bignum.h"
+
+#include <vector>
+#include <cstdint>
+
+namespace Modular {
+	// Type of the residues (always in Montgomery form, see below)
+	typedef std::uint32_t residue_t;
+
+	/* class primeSet keeps a set of distinct primes below 2^31 and does arithmetic on
+	 * residue vectors, which are flat arrays with one residue per prime of the set (in
+	 * the order the primes were added)
+	 * The residues are kept in Montgomery form (with R = 2^32), so that every product
+	 * only takes integer multiplications, and the operations on vectors have the same
+	 * instructions for every prime (which allows the compiler to vectorize them)
+	 * The exact values are obtained by the chinese remainder theorem followed by
+	 * rational reconstruction (possibly from only the first primes of the set, so that
+	 * the others can be used to check the result)
+	 */
+	class primeSet {
+	public:
+		explicit primeSet(unsigned long = 0);
+
+		unsigned long size() const;
+		const BigNum::bignum& product() const;
+		const BigNum::bignum& product(unsigned long) const;
+		void addPrime();
+
+		void fromBignum(const BigNum::bignum&, residue_t*) const;
+		bool fromFrac(const BigNum::frac&, residue_t*) const;
+
+		void add(residue_t*, const residue_t*) const;
+		void subtract(residue_t*, const residue_t*) const;
+		void multiply(residue_t*, const residue_t*, const residue_t*) const;
+		void addmul(residue_t*, const residue_t*, const residue_t*) const;
+		void submul(residue_t*, const residue_t*, const residue_t*) const;
+		bool zero(const residue_t*) const;
+
+		bool agrees(const residue_t*, const BigNum::frac&) const;
+
+		BigNum::bignum combine(const residue_t*, unsigned long) const;
+		bool reconstruct(const residue_t*,
+						 const BigNum::bignum&,
+						 const BigNum::bignum&,
+						 BigNum::frac&,
+						 unsigned long) const;
+
+	private:
+		// The data of the primes (structure of arrays)
+		std::vector<residue_t> primes, negInverses, squaredRs, garnerInverses;
+		// prods[i] is the product of the first i primes
+		std::vector<BigNum::bignum> prods;
+
+		residue_t reduce(std::uint64_t, unsigned long) const;
+		residue_t power(residue_t, residue_t, unsigned long) const;
+	};
+}
+
+/* Local Variables: */
+/* mode: c++ */
+/* tab-width: 4 */
+/* End: */
+#endif
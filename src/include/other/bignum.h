@@ -6,6 +6,22 @@
 #include <utility>
 #include <iostream>
 #include <cstdio>
+#include <climits>
+#include <algorithm>
+
+/* BIGNUM_LIMB_BITS selects the size of the words (limbs) in which bignum stores its
+ * magnitude. The default is 64 bits with unsigned __int128 intermediate products when
+ * the compiler provides it (and long has 64 bits) and 32 bits with 64-bit products
+ * otherwise. The value 8 selects the original byte-sized layout (kept only for
+ * comparisons).
+ */
+#ifndef BIGNUM_LIMB_BITS
+#if defined(__SIZEOF_INT128__) && ULONG_MAX > 0xffffffffUL
+#define BIGNUM_LIMB_BITS 64
+#else
+#define BIGNUM_LIMB_BITS 32
+#endif
+#endif
 
 namespace BigNum {
 	// Forward declarations
@@ -31,7 +47,9 @@ namespace BigNum {
         bignum();
         explicit bignum(long);
         bignum(const bignum&);
+        bignum(bignum&&) noexcept;
         bignum& operator=(const bignum&);
+        bignum& operator=(bignum&&) noexcept;
 
         bignum operator+(const bignum&) const;
         bignum operator-(const bignum&) const;
@@ -49,6 +67,9 @@ namespace BigNum {
         bignum& operator<<=(long);
         bignum& operator>>=(long);
 
+		bignum& addmul(const bignum&, const bignum&);
+		bignum& submul(const bignum&, const bignum&);
+
         const bignum& operator+() const;
         bignum operator-() const;
 
@@ -69,6 +90,8 @@ namespace BigNum {
 		bignum& invert();
 		bignum& removeSignal();
 
+		unsigned long residue(unsigned long) const;
+
 		std::istream& readFromStream(std::istream&, base = decimal);
 		int readFromFILE(FILE*, base = decimal);
 
@@ -85,20 +108,143 @@ namespace BigNum {
 		void swap(bignum&);
 
 	protected:
+#if BIGNUM_LIMB_BITS == 64
+		typedef unsigned long elem_t;
+		__extension__ typedef unsigned __int128 wide_t;
+#elif BIGNUM_LIMB_BITS == 32
+		typedef unsigned int elem_t;
+#if ULONG_MAX > 0xffffffffUL
+		typedef unsigned long wide_t;
+#else
+		typedef unsigned long long wide_t;
+#endif
+#elif BIGNUM_LIMB_BITS == 8
 		typedef unsigned char elem_t;
 		typedef unsigned short wide_t;
+#else
+#error "BIGNUM_LIMB_BITS must be 64, 32 or 8"
+#endif
 		static const size_t bitsElem;
 		static const elem_t maxElem;
 
-        mutable std::vector<elem_t> v;
-        mutable bool sgn;
-
-		void adjust() const;
-		void shrink() const;
-		bignum unsignedAdd(const bignum&, bool = true) const;
-		bignum unsignedSubtract(const bignum&, bool = true) const;
+		/* class elemVector is the storage of the elements of a bignum: numbers that fit
+		 * in two machine words are kept inside the object itself and larger numbers are
+		 * moved transparently to the heap (only the part of std::vector's interface that
+		 * bignum needs is provided)
+		 */
+		class elemVector {
+		public:
+			elemVector() : sz(0), cap(inlineElems) {}
+			elemVector(const elemVector&);
+			elemVector(elemVector&& other) noexcept : sz(other.sz), cap(other.cap) {
+				// the inline elements overlay the heap pointer, so copying them copies
+				// whichever of the two is in use
+				std::copy(other.local, other.local + inlineElems, local);
+				other.sz = 0;
+				other.cap = inlineElems;
+			}
+			~elemVector() {
+				if (cap > inlineElems)
+					delete[] heap;
+			}
+			elemVector& operator=(const elemVector&);
+			elemVector& operator=(elemVector&& other) noexcept {
+				if (this != &other) {
+					if (cap > inlineElems)
+						delete[] heap;
+					sz = other.sz;
+					cap = other.cap;
+					std::copy(other.local, other.local + inlineElems, local);
+					other.sz = 0;
+					other.cap = inlineElems;
+				}
+				return *this;
+			}
+
+			unsigned long size() const { return sz; }
+			bool empty() const { return !sz; }
+			elem_t& operator[](unsigned long i) { return data()[i]; }
+			const elem_t& operator[](unsigned long i) const { return data()[i]; }
+			elem_t& front() { return data()[0]; }
+			const elem_t& front() const { return data()[0]; }
+			elem_t& back() { return data()[sz - 1]; }
+			const elem_t& back() const { return data()[sz - 1]; }
+			bool operator==(const elemVector&) const;
+
+			void resize(unsigned long);
+			void reserve(unsigned long);
+			void push_back(elem_t);
+			void assign(const elem_t*, const elem_t*);
+			void swap(elemVector&);
+			void shrinkToFit();
+
+		private:
+			enum { inlineElems = 2 * sizeof(unsigned long) / sizeof(elem_t) };
+
+			unsigned int sz, cap;
+			union {
+				elem_t* heap;
+				elem_t local[inlineElems];
+			};
+
+			elem_t* data() { return cap > inlineElems? heap : local; }
+			const elem_t* data() const { return cap > inlineElems? heap : local; }
+			void reallocate(unsigned long);
+		};
+
+		// Multiplication algorithm thresholds (in elements)
+		static const unsigned long karatsubaThreshold, toom3Threshold;
+		static const unsigned long karatsubaSqrThreshold, toom3SqrThreshold;
+		static const unsigned long fromDigitsThreshold, toDigitsThreshold;
+
+        elemVector v;
+        bool sgn;
+
+		void adjust();
+		void shrink();
+		unsigned long bitLength() const;
+		elem_t divideByElem(elem_t);
+		unsigned long shiftedBits(unsigned long) const;
+		bool toLong(long&) const;
+		int compareMagnitude(const bignum&) const;
+		void addMagnitude(const bignum&);
+		void subtractMagnitude(const bignum&);
+		void multiplyByElem(elem_t);
+		bignum& fusedMultiplyAdd(const bignum&, const bignum&, bool);
+		void appendDigits(std::string&, unsigned long, base) const;
+
+		static bignum fromUnsignedLong(unsigned long);
+		static bignum fromElems(const elem_t*, unsigned long);
+		static bignum fromDigits(const char*, unsigned long, base);
+		static unsigned long digitsPerElem(base);
+		static const bignum& chunkPower(base, unsigned long);
+		static elem_t addElems(elem_t*, const elem_t*, unsigned long,
+							   const elem_t*, unsigned long);
+		static int compareElems(const elem_t*, unsigned long, const elem_t*, unsigned long);
+		static elem_t addToElems(elem_t*, unsigned long, const elem_t*, unsigned long);
+		static elem_t subtractFromElems(elem_t*, unsigned long,
+										const elem_t*, unsigned long);
+		static void reverseSubtractElems(elem_t*, const elem_t*, unsigned long);
+		static elem_t addMultipleToElems(elem_t*, unsigned long,
+										 const elem_t*, unsigned long, elem_t);
+		static void multiplyElems(elem_t*, const elem_t*, unsigned long,
+								  const elem_t*, unsigned long);
+		static void multiplySchoolbook(elem_t*, const elem_t*, unsigned long,
+									   const elem_t*, unsigned long);
+		static void multiplyKaratsuba(elem_t*, const elem_t*, unsigned long,
+									  const elem_t*, unsigned long);
+		static void multiplyToom3(elem_t*, const elem_t*, unsigned long,
+								  const elem_t*, unsigned long);
+		static void interpolateToom3(elem_t*, unsigned long, unsigned long,
+									 bignum&, bignum&, bignum&, bignum&, bignum&);
+		static void squareElems(elem_t*, const elem_t*, unsigned long);
+		static void squareSchoolbook(elem_t*, const elem_t*, unsigned long);
+		static void squareKaratsuba(elem_t*, const elem_t*, unsigned long);
+		static void squareToom3(elem_t*, const elem_t*, unsigned long);
 
 		friend divRes divide(bignum, bignum);
+		friend bignum gcd(bignum, bignum);
+		friend class frac;
     };
 
 	// These are useful bignum constants
@@ -110,7 +256,9 @@ namespace BigNum {
         explicit frac(long = 0, long = 1);
         explicit frac(const bignum&, const bignum& = bn1);
         frac(const frac&);
+        frac(frac&&) noexcept;
         frac& operator=(const frac&);
+        frac& operator=(frac&&) noexcept;
 
         frac operator+(const frac&) const;
         frac operator-(const frac&) const;
@@ -122,6 +270,9 @@ namespace BigNum {
         frac& operator*=(const frac&);
         frac& operator/=(const frac&);
 
+		frac& addmul(const frac&, const frac&);
+		frac& submul(const frac&, const frac&);
+
         const frac& operator+() const;
         frac operator-() const;
 
@@ -141,6 +292,9 @@ namespace BigNum {
 		frac& invertProd();
 		frac& removeSignal();
 
+		const bignum& numerator() const;
+		const bignum& denominator() const;
+
 		std::istream& readFromStream(std::istream&, base = decimal);
 		std::istream& readFromStreamPoint(std::istream&, base = decimal);
 		int readFromFILE(FILE*, base = decimal);
@@ -168,13 +322,45 @@ namespace BigNum {
 		void swap(frac&);
 
 	protected:
-        mutable bignum num, den;
+        bignum num, den;
 
-        void reduce() const;
+        void reduce();
+		bool addSmall(long, long, long, long);
+		bool multiplySmall(long, long, long, long);
+		frac& fusedMultiplyAdd(const frac&, const frac&, bool);
+		void assignDecimal(bool, const char*, unsigned long, long);
+		std::istream& readFromStreamDecimal(std::istream&);
+		int readFromFILEDecimal(FILE*);
 
 		friend fracDivRes divide(frac, frac);
+		friend frac doubleToFrac(double);
+		friend class fracSum;
     };
 
+	/* class fracSum accumulates long sums of fracs: the terms are brought to a common
+	 * denominator (the lcm of the denominators seen so far) and the sum is reduced only
+	 * when its value is read
+	 */
+	class fracSum {
+	public:
+		fracSum();
+		explicit fracSum(const frac&);
+
+		fracSum& operator+=(const frac&);
+		fracSum& operator-=(const frac&);
+
+		fracSum& addmul(const frac&, const frac&);
+		fracSum& submul(const frac&, const frac&);
+
+		bool zero() const;
+		frac value() const;
+
+	protected:
+		bignum num, den;
+
+		void addTerm(const bignum&, const bignum&, bool);
+	};
+
     bignum pow(bignum, unsigned long);
     frac pow(frac, long);
 
@@ -190,6 +376,7 @@ namespace BigNum {
     const bignum& binomial(unsigned long, unsigned long);
 
     bignum gcd(bignum, bignum);
+	bignum divideByGcd(bignum&, bignum&);
     bignum lcm(const bignum&, const bignum&);
 	bignum ascendingLcm(unsigned long);
 
@@ -199,6 +386,8 @@ namespace BigNum {
     double fracToDouble(const frac&);
 	frac doubleToFrac(double);
 
+	std::vector<frac> humanRounded(const std::vector<frac>&, unsigned long);
+
 	std::ostream& operator<<(std::ostream&, const bignum&);
 	std::ostream& operator<<(std::ostream&, const frac&);
 
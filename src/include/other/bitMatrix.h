@@ -0,0 +1,127 @@
+#ifndef BITMATRIX_H_INCLUDED
+#define BITMATRIX_H_INCLUDED
+
+#include <vector>
+#include <cstdint>
+
+namespace BitMatrix {
+	// Type of the words in which the rows are packed
+	typedef std::uint64_t word_t;
+	const unsigned long bitsWord(64);
+
+	/* class bitMatrix keeps a square matrix of bits with each row packed in machine
+	 * words (bit j of a row is bit j % bitsWord of its (j / bitsWord)-th word), so that
+	 * rows are counted, compared and gathered a word at a time
+	 * note: the bits past the last column are always 0
+	 */
+	class bitMatrix {
+	public:
+		bitMatrix() : n(0), w(0) {}
+		explicit bitMatrix(unsigned long size)
+			: n(size), w(words(size)), bits(size * words(size)) {}
+
+		/* words(unsigned long size):
+		 * returns: number of words in a row of a matrix of size size
+		 */
+		static unsigned long words(unsigned long size) {
+			return (size + bitsWord - 1) / bitsWord;
+		}
+
+		unsigned long size() const { return n; }
+		unsigned long wordsPerRow() const { return w; }
+		const word_t* row(unsigned long i) const { return bits.data() + i * w; }
+
+		bool test(unsigned long i, unsigned long j) const {
+			return (bits[i * w + j / bitsWord] >> (j % bitsWord)) & 1;
+		}
+		void set(unsigned long i, unsigned long j, bool b = true) {
+			const word_t mask(word_t(1) << (j % bitsWord));
+			word_t& word(bits[i * w + j / bitsWord]);
+			word = b? word | mask : word & ~mask;
+		}
+		bool operator==(const bitMatrix& other) const {
+			return n == other.n && bits == other.bits;
+		}
+
+		unsigned long rowCount(unsigned long) const;
+		void setColumn(unsigned long, const word_t*);
+		bool rowsAgree(unsigned long, const bitMatrix&, unsigned long, unsigned long) const;
+		bitMatrix submatrix(const std::vector<unsigned long>&) const;
+
+	private:
+		unsigned long n, w;
+		std::vector<word_t> bits;
+	};
+
+	/* rowCount(unsigned long i) const:
+	 * restrictions: i < size()
+	 * returns: number of bits set in the i-th row
+	 */
+	inline unsigned long bitMatrix::rowCount(unsigned long i) const {
+		unsigned long ret(0);
+		for (const word_t *p(row(i)), *e(p + w); p != e; ++p)
+			ret += __builtin_popcountll(*p);
+		return ret;
+	}
+
+	/* setColumn(unsigned long j, const word_t* col):
+	 * restrictions: j < size() and col points to wordsPerRow() words
+	 * makes the j-th column be the bits of col (bit i of col goes to row i)
+	 */
+	inline void bitMatrix::setColumn(unsigned long j, const word_t *col) {
+		const unsigned long shift(j % bitsWord);
+		word_t *p(bits.data() + j / bitsWord);
+		for (unsigned long i = 0; i < n; ++i, p += w)
+			*p = (*p & ~(word_t(1) << shift))
+				| (((col[i / bitsWord] >> (i % bitsWord)) & 1) << shift);
+	}
+
+	/* rowsAgree(unsigned long i, const bitMatrix& other, unsigned long j,
+	 *           unsigned long len) const:
+	 * restrictions: other.size() == size(), i, j < size() and len <= size()
+	 * returns: true, iff the first len bits of the i-th row of *this are equal to the
+	 *          first len bits of the j-th row of other
+	 */
+	inline bool bitMatrix::rowsAgree(unsigned long i,
+									 const bitMatrix& other,
+									 unsigned long j,
+									 unsigned long len) const {
+		const word_t *a(row(i)), *b(other.row(j));
+		const unsigned long full(len / bitsWord);
+		for (unsigned long k = 0; k < full; ++k)
+			if (a[k] != b[k])
+				return false;
+		if (len % bitsWord)
+			return !((a[full] ^ b[full]) & ((word_t(1) << (len % bitsWord)) - 1));
+		return true;
+	}
+
+	/* submatrix(const std::vector<unsigned long>& sel) const:
+	 * restrictions: sel is strictly increasing and its elements are less than size()
+	 * returns: the matrix of the rows and columns of indexes in sel (in the same order)
+	 * note: only the bits that are set are visited (the columns are gathered through the
+	 *       set bits of each selected row masked by the selection)
+	 */
+	inline bitMatrix bitMatrix::submatrix(const std::vector<unsigned long>& sel) const {
+		bitMatrix ret(sel.size());
+		std::vector<word_t> mask(w);
+		std::vector<unsigned long> newIndex(n);
+		for (unsigned long k = 0; k < sel.size(); ++k) {
+			mask[sel[k] / bitsWord] |= word_t(1) << (sel[k] % bitsWord);
+			newIndex[sel[k]] = k;
+		}
+		for (unsigned long k = 0; k < sel.size(); ++k) {
+			const word_t *src(row(sel[k]));
+			for (unsigned long l = 0; l < w; ++l)
+				for (word_t word(src[l] & mask[l]); word; word &= word - 1)
+					ret.set(k, newIndex[l * bitsWord + __builtin_ctzll(word)]);
+		}
+		return ret;
+	}
+}
+
+/* Local Variables: */
+/* mode: c++ */
+/* tab-width: 4 */
+/* End: */
+#endif
@@ -1,38 +1,47 @@
 #include "FlagDigraph.h"
 
 #include <algorithm>
+#include <unordered_set>
 
 using namespace FlagAlgebra;
+using namespace BitMatrix;
 using namespace std;
 
 /* default constructor
  * constructs a digraph of size 0
  */
-Digraph::Digraph() : s(0), m() {}
+Digraph::Digraph() : s(0), m(), t() {}
 
 /* copy constructor
  */
-Digraph::Digraph(const Digraph& other) : s(other.s), m(other.m) {}
+Digraph::Digraph(const Digraph& other) : s(other.s), m(other.m), t(other.t) {}
 
 /* Digraph(const vector<vbool>& mat):
  * restriction: mat must be the adjacency matrix of a digraph
  * (i.e., must be symmetric and with diagonal 0)
  * constructs the digraph with adjacency matrix mat
  */
-Digraph::Digraph(const vector<vbool>& mat) : s(mat.size()), m(mat.size()*mat.size()) {
+Digraph::Digraph(const vector<vbool>& mat)
+	: s(mat.size()), m(mat.size()), t(mat.size()) {
 	for (unsigned long i = 0; i < s; ++i)
 		for (unsigned long j = 0; j < s; ++j)
-			m[s*i+j] = mat[i][j];
+			if (mat[i][j]) {
+				m.set(i, j);
+				t.set(j, i);
+			}
 }
 
 /* Digraph(unsigned long size, const bool **mat):
  * restrictions: mat[0..size-1][0..size-1] must be the adjacency matrix of a digraph
  * constructs the digraph with adjacency matrix mat[0..size-1][0..size-1]
  */
-Digraph::Digraph(unsigned long size, const bool **mat) : s(size), m(size*size) {
+Digraph::Digraph(unsigned long size, const bool **mat) : s(size), m(size), t(size) {
 	for (unsigned long i = 0; i < size; ++i)
 		for (unsigned long j = 0; j < size; ++j)
-			m[s*i+j] = mat[i][j];
+			if (mat[i][j]) {
+				m.set(i, j);
+				t.set(j, i);
+			}
 }
 
 /* copy operator
@@ -40,6 +49,7 @@ Digraph::Digraph(unsigned long size, const bool **mat) : s(size), m(size*size) {
 Digraph& Digraph::operator=(const Digraph& other) {
 	s = other.s;
 	m = other.m;
+	t = other.t;
 	return *this;
 }
 
@@ -63,11 +73,8 @@ Digraph Digraph::subobject(const vbool& sel) const {
 
 	Digraph ret;
 	ret.s = v.size();
-	ret.m.resize(ret.s*ret.s);
-
-	for (unsigned long i = 0; i < v.size(); ++i)
-		for (unsigned long j = 0; j < v.size(); ++j)
-			ret.m[ret.s*i+j] = m[s*v[i]+v[j]];
+	ret.m = m.submatrix(v);
+	ret.t = t.submatrix(v);
 	return ret;
 }
 
@@ -84,6 +91,39 @@ public:
 };
 
 
+/* refineAssignment(const Digraph& other,
+ *                  unsigned long v,
+ *                  unsigned long image,
+ *                  unsigned long index,
+ *                  vector< vector<unsigned long> >& colours,
+ *                  vector< vector<unsigned long> >& otherColours) const:
+ * auxiliary function of completeIsomorphism: individualizes v and image in the
+ * colourings of position index and refines them into the colourings of position index + 1
+ * returns: false, iff the refined colourings show that v can not be mapped to image
+ */
+bool Digraph::refineAssignment(const Digraph& other,
+							   unsigned long v,
+							   unsigned long image,
+							   unsigned long index,
+							   vector< vector<unsigned long> >& colours,
+							   vector< vector<unsigned long> >& otherColours) const {
+	if (index + 1 == size())
+		return true;
+	if (count(colours[index].begin(), colours[index].end(), colours[index][v]) == 1) {
+		// v is already individualized, so is image and refining changes nothing
+		colours[index + 1] = colours[index];
+		otherColours[index + 1] = otherColours[index];
+		return true;
+	}
+	vector<unsigned long> seed(colours[index]), otherSeed(otherColours[index]);
+	for (unsigned long w = 0; w < size(); ++w) {
+		seed[w] = 2 * seed[w] + (w != v);
+		otherSeed[w] = 2 * otherSeed[w] + (w != image);
+	}
+	return Canonical::refinedPair(m, t, seed, other.m, other.t, otherSeed,
+								  colours[index + 1], otherColours[index + 1]);
+}
+
 /* completeIsomorphism(const Digraph& other, morphism& f) const:
  * assumes f holds a partial function from the vertices of *this to the vertices
  * of other (indicating undefined values by f[v] = other.size()) and tries to
@@ -113,8 +153,12 @@ bool Digraph::completeIsomorphism(const Digraph& other, morphism& f) const {
 
 	typedef pair<unsigned long, bool> vertexBool;
 
-	vector< vector< vector<vertexBool> > > notUsed(size(),
-												   vector< vector<vertexBool> >(size()));
+	/* The unused vertices of other are kept grouped by degree pairs (in increasing order
+	 * of index inside each group), and the candidates of v are the group
+	 * [firstCandidate[v], lastCandidate[v]) of the vertices with the degrees of v
+	 */
+	vector<vertexBool> notUsed;
+	vector<unsigned long> firstCandidate(size()), lastCandidate(size());
 	vector<unsigned long> order(size());
 	unsigned long start = 0;
 	/* Backtrack order setup block */{
@@ -131,11 +175,24 @@ bool Digraph::completeIsomorphism(const Digraph& other, morphism& f) const {
 				order[--index] = ordDeg[i-1].second;
 			}
 		}
+		vector<degreeIndex> unusedDeg;
 		for (unsigned long i = 0; i < size(); ++i)
 			if (!used[i])
-				notUsed[otherDeg[i].first][otherDeg[i].second]
-					.push_back(vertexBool(i, true));
-	}	
+				unusedDeg.push_back(degreeIndex(otherDeg[i], i));
+		stable_sort(unusedDeg.begin(), unusedDeg.end(), compFirstDegreeIndex());
+		notUsed.reserve(unusedDeg.size());
+		for (unsigned long i = 0; i < unusedDeg.size(); ++i)
+			notUsed.push_back(vertexBool(unusedDeg[i].second, true));
+		for (unsigned long i = 0; i < size(); ++i) {
+			pair<vector<degreeIndex>::iterator, vector<degreeIndex>::iterator>
+				range(equal_range(unusedDeg.begin(),
+								  unusedDeg.end(),
+								  degreeIndex(deg[i], 0),
+								  compFirstDegreeIndex()));
+			firstCandidate[i] = range.first - unusedDeg.begin();
+			lastCandidate[i] = range.second - unusedDeg.begin();
+		}
+	}
 
     /* Given partial checking block */ {
 		for (unsigned long i = 0; i < start; ++i)
@@ -144,51 +201,79 @@ bool Digraph::completeIsomorphism(const Digraph& other, morphism& f) const {
 
 		for (unsigned long i = 0; i < start; ++i)
 			for (unsigned long j = 0; j < start; ++j)
-				if (m[size()*order[i] + order[j]]
-					!= other.m[size()*f[order[i]] + f[order[j]]])
+				if (m.test(order[i], order[j]) != other.m.test(f[order[i]], f[order[j]]))
 					return false;
 	}
+
+	/* The arcs are compared in the backtrack order: bit p of row v of outOrdered
+	 * (inOrdered) is whether there is an arc from v to order[p] (from order[p] to v),
+	 * and likewise for the rows of other with f[order[p]] (only the bits of the
+	 * positions already mapped are meaningful), so that checking a candidate image is
+	 * a masked comparison of two pairs of rows
+	 */
+	bitMatrix outOrdered(size()), inOrdered(size());
+	bitMatrix otherOutOrdered(size()), otherInOrdered(size());
+	for (unsigned long p = 0; p < size(); ++p) {
+		outOrdered.setColumn(p, t.row(order[p]));
+		inOrdered.setColumn(p, m.row(order[p]));
+	}
+	for (unsigned long p = 0; p < start; ++p) {
+		otherOutOrdered.setColumn(p, other.t.row(f[order[p]]));
+		otherInOrdered.setColumn(p, other.m.row(f[order[p]]));
+	}
+
+	/* Colour refinement block: the vertices already mapped get the same distinct colour
+	 * as their images and the colourings are refined (see Canonical::refinedPair);
+	 * colours[p] and otherColours[p] are the refinements with the vertices of the
+	 * positions below p individualized, and a vertex may only be mapped to a vertex of
+	 * its colour
+	 */
+	vector< vector<unsigned long> > colours(size() + 1), otherColours(size() + 1);
+	/* Initial colouring block */ {
+		vector<unsigned long> seed(size()), otherSeed(size());
+		for (unsigned long p = 0; p < start; ++p)
+			seed[order[p]] = otherSeed[f[order[p]]] = p + 1;
+		if (!Canonical::refinedPair(m, t, seed, other.m, other.t, otherSeed,
+									colours[start], otherColours[start]))
+			return false;
+		for (unsigned long p = 0; p < start; ++p)
+			if (colours[start][order[p]] != otherColours[start][f[order[p]]])
+				return false;
+	}
  
     /* Isomorphism completion block */ {
 		unsigned long index;
 		vector<unsigned long> btind(size());
 		for (index = start; start <= index && index < size(); ) {
 			const unsigned long v(order[index]);
-			vector<vertexBool>& candidates(notUsed[deg[v].first][deg[v].second]);
+			const unsigned long last(lastCandidate[v]);
 			unsigned long& thisind(btind[v]);
 
 			if (f[v] == size())
-				thisind = 0;
+				thisind = firstCandidate[v];
 			else {
-				candidates[thisind].second = true;
+				notUsed[thisind].second = true;
 				f[v] = size();
 				++thisind;
 			}
 			while (true) {
-				for ( ; thisind < candidates.size(); ++thisind)
-					if (candidates[thisind].second)
+				for ( ; thisind < last; ++thisind)
+					if (notUsed[thisind].second)
 						break;
-				if (thisind == candidates.size()) {
+				if (thisind == last) {
 					--index;
 					break;
 				}
-				const unsigned long image(candidates[thisind].first);
-				const unsigned long vLine(v * size());
-				const unsigned long imageLine(image * size());
-				unsigned long morphind;
-				for (morphind = 0; morphind < index; ++morphind) {
-					if (m[vLine + order[morphind]]
-						!= other.m[imageLine + f[order[morphind]]])
-						// Arcs from v to previously defined
-						break;
-					if (m[order[morphind]*size() + v]
-						!= other.m[f[order[morphind]]*size() + image])
-						// Arcs from  previously defined to v
-						break;
-				}
-				if (morphind == index) {
-					candidates[thisind].second = false;
+				const unsigned long image(notUsed[thisind].first);
+				if (otherColours[index][image] == colours[index][v]
+					&& outOrdered.rowsAgree(v, otherOutOrdered, image, index)
+					&& inOrdered.rowsAgree(v, otherInOrdered, image, index)
+					&& refineAssignment(other, v, image, index,
+											colours, otherColours)) {
+					notUsed[thisind].second = false;
 					f[v] = image;
+					otherOutOrdered.setColumn(index, other.t.row(image));
+					otherInOrdered.setColumn(index, other.m.row(image));
 					++index;
 					break;
 				}
@@ -224,16 +309,50 @@ bool Digraph::operator!=(const Digraph& other) const {
 	return !operator==(other);
 }
 
+/* certificate(morphism* pm) const:
+ * returns: the certificate of the digraph (two digraphs have equal certificates iff
+ *          they are isomorphic)
+ * note: if pm is not null, the canonical labelling is put on *pm
+ */
+Canonical::certificate_t Digraph::certificate(morphism* pm) const {
+	return certificate(vector<unsigned long>(s), pm);
+}
+
+/* certificate(const vector<unsigned long>& colours, morphism* pm) const:
+ * restrictions: colours.size() == size()
+ * returns: the certificate of the digraph with vertex v coloured colours[v] (two
+ *          coloured digraphs have equal certificates iff there is a colour preserving
+ *          isomorphism between them)
+ * note: if pm is not null, the canonical labelling is put on *pm
+ */
+Canonical::certificate_t Digraph::certificate(const vector<unsigned long>& colours,
+											  morphism* pm) const {
+	morphism lab;
+	Canonical::certificate_t ret(Canonical::canonicalLabelling(m, t, colours, lab));
+	if (pm)
+		pm->swap(lab);
+	return ret;
+}
+
+/* canonicalForm() const:
+ * returns: the digraph isomorphic to *this with the canonical labelling
+ */
+Digraph Digraph::canonicalForm() const {
+	morphism lab;
+	certificate(&lab);
+	Digraph ret;
+	ret.s = s;
+	ret.m = Canonical::relabelled(m, lab);
+	ret.t = Canonical::relabelled(t, lab);
+	return ret;
+}
+
 /* outDegree(unsigned long v) const:
  * restrictions: v < size()
  * returns: out-degree of vertex v (number of arcs leaving v)
  */
 unsigned long Digraph::outDegree(unsigned long v) const {
-	unsigned long ret(0), line(v*size()), upper(line+size());
-	for (unsigned long i = line; i < upper; ++i)
-		if (m[i])
-			++ret;
-	return ret;
+	return m.rowCount(v);
 }
 
 /* inDegree(unsigned long v) const:
@@ -241,11 +360,7 @@ unsigned long Digraph::outDegree(unsigned long v) const {
  * returns: in-degree of vertex v (number of arcs entering v)
  */
 unsigned long Digraph::inDegree(unsigned long v) const {
-	unsigned long ret(0);
-	for (unsigned long i = v; i < m.size(); i += s)
-		if (m[i])
-			++ret;
-	return ret;
+	return t.rowCount(v);
 }
 
 /* enumerate(unsigned long size):
@@ -255,6 +370,9 @@ container<Digraph> Digraph::enumerate(unsigned long size) {
 	vector<vbool> mat(size, vbool(size));
 	vector<unsigned long> inDegrees(size), outDegrees(size);
 	container<Digraph> ret(1, Digraph(mat));
+	// certificates of the digraphs of ret
+	unordered_set<Canonical::certificate_t, Canonical::certificateHash> found;
+	found.insert(ret[0].certificate());
 
 	while (true) {
 		unsigned long inci(0), incj(0);
@@ -296,10 +414,7 @@ container<Digraph> Digraph::enumerate(unsigned long size) {
 		if (index < size)
 			continue;
 		Digraph D(mat);
-		for (index = 0; index < ret.size(); ++index)
-			if (D == ret[index])
-				break;
-		if (index == ret.size())
+		if (found.insert(D.certificate()).second)
 			ret.push_back(D);
 	}
 	return ret;
@@ -326,11 +441,13 @@ The vertices of the digraph are labeled in 0..n-1
 int Digraph::readFromFile(FILE *f) {
 	if (fscanf(f, " (%lu", &s) != 1)
 		return -1;
-	m.assign(s*s, false);
+	m = bitMatrix(s);
+	t = bitMatrix(s);
 	unsigned long a, b;
 	int ret;
 	while ((ret = fscanf(f, "%lu %lu", &a, &b)) == 2) {
-		m[a*s + b] = true;
+		m.set(a, b);
+		t.set(b, a);
 	}
 	if (ret != 0)
 		return -1;
@@ -346,7 +463,7 @@ void Digraph::writeOnFile(FILE *f) const {
 	fprintf(f, "(%lu\n", s);
 	for (unsigned long i = 0; i < s; ++i)
 		for (unsigned long j = 0; j < s; ++j)
-			if (m[i*s + j])
+			if (m.test(i, j))
 				fprintf(f, "%lu %lu\n", i, j);
 	fprintf(f, ")");
 }
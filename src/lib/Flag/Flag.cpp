@@ -15,6 +15,29 @@ unsigned long FlagAlgebra::fracPrecision(std::numeric_limits<double>::digits10+1
 // This is the size of the progress bar shown by the SDPprograms
 unsigned long FlagAlgebra::progressBarSize(19);
 
+/* This is the maximum number of threads used by the functions that split their work
+ * among threads (0 means one per hardware thread), programs are free to alter its value
+ */
+unsigned long FlagAlgebra::maxThreads(0);
+
+/* Lock of the memoized tables of the enumerating functions (they are filled
+ * recursively, so the lock is recursive)
+ */
+std::recursive_mutex FlagAlgebra::memoMutex;
+
+/* threadCount(unsigned long n):
+ * returns: the number of threads to split n independent tasks among: maxThreads (or the
+ *          number of hardware threads, if maxThreads is 0), but at least 1 and at most n
+ */
+unsigned long FlagAlgebra::threadCount(unsigned long n) {
+	unsigned long threads(maxThreads? maxThreads : thread::hardware_concurrency());
+	if (!threads)
+		threads = 1;
+	if (threads > n)
+		threads = n;
+	return threads;
+}
+
 // FlagException class functions
 /* default constructor
  */
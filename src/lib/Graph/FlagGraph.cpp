@@ -1,8 +1,10 @@
 #include "FlagGraph.h"
 
 #include <algorithm>
+#include <unordered_set>
 
 using namespace FlagAlgebra;
+using namespace BitMatrix;
 using namespace std;
 
 /* default constructor
@@ -19,10 +21,10 @@ Graph::Graph(const Graph& other) : s(other.s), m(other.m) {}
  * (i.e., must be symmetric and with diagonal 0)
  * constructs the graph with adjacency matrix mat
  */
-Graph::Graph(const vector<vbool>& mat) : s(mat.size()), m(mat.size()*mat.size()) {
+Graph::Graph(const vector<vbool>& mat) : s(mat.size()), m(mat.size()) {
 	for (unsigned long i = 0; i < s; ++i)
 		for (unsigned long j = 0; j < s; ++j)
-			m[s*i+j] = mat[i][j];
+			m.set(i, j, mat[i][j]);
 }
 
 /* Graph(unsigned long size, const bool **mat):
@@ -30,10 +32,10 @@ Graph::Graph(const vector<vbool>& mat) : s(mat.size()), m(mat.size()*mat.size())
  * of a graph (i.e., must be symmetric and with diagonal 0)
  * constructs the graph with adjacency matrix mat[0..size-1][0..size-1]
  */
-Graph::Graph(unsigned long size, const bool **mat) : s(size), m(size*size) {
+Graph::Graph(unsigned long size, const bool **mat) : s(size), m(size) {
 	for (unsigned long i = 0; i < size; ++i)
 		for (unsigned long j = 0; j < size; ++j)
-			m[s*i+j] = mat[i][j];
+			m.set(i, j, mat[i][j]);
 }
 
 /* copy operator
@@ -64,11 +66,7 @@ Graph Graph::subobject(const vbool& sel) const {
 
 	Graph ret;
 	ret.s = v.size();
-	ret.m.resize(ret.s*ret.s);
-
-	for (unsigned long i = 0; i < v.size(); ++i)
-		for (unsigned long j = 0; j < v.size(); ++j)
-			ret.m[ret.s*i+j] = m[s*v[i]+v[j]];
+	ret.m = m.submatrix(v);
 	return ret;
 }
 
@@ -84,6 +82,39 @@ public:
 };
 
 
+/* refineAssignment(const Graph& other,
+ *                  unsigned long v,
+ *                  unsigned long image,
+ *                  unsigned long index,
+ *                  vector< vector<unsigned long> >& colours,
+ *                  vector< vector<unsigned long> >& otherColours) const:
+ * auxiliary function of completeIsomorphism: individualizes v and image in the
+ * colourings of position index and refines them into the colourings of position index + 1
+ * returns: false, iff the refined colourings show that v can not be mapped to image
+ */
+bool Graph::refineAssignment(const Graph& other,
+							 unsigned long v,
+							 unsigned long image,
+							 unsigned long index,
+							 vector< vector<unsigned long> >& colours,
+							 vector< vector<unsigned long> >& otherColours) const {
+	if (index + 1 == size())
+		return true;
+	if (count(colours[index].begin(), colours[index].end(), colours[index][v]) == 1) {
+		// v is already individualized, so is image and refining changes nothing
+		colours[index + 1] = colours[index];
+		otherColours[index + 1] = otherColours[index];
+		return true;
+	}
+	vector<unsigned long> seed(colours[index]), otherSeed(otherColours[index]);
+	for (unsigned long w = 0; w < size(); ++w) {
+		seed[w] = 2 * seed[w] + (w != v);
+		otherSeed[w] = 2 * otherSeed[w] + (w != image);
+	}
+	return Canonical::refinedPair(m, m, seed, other.m, other.m, otherSeed,
+								  colours[index + 1], otherColours[index + 1]);
+}
+
 /* completeIsomorphism(const Graph& other, morphism& f) const:
  * assumes f holds a partial function from the vertices of *this to the vertices
  * of other (indicating undefined values by f[v] = other.size()) and tries to
@@ -139,10 +170,39 @@ bool Graph::completeIsomorphism(const Graph& other, morphism& f) const {
 
 		for (unsigned long i = 0; i < start; ++i)
 			for (unsigned long j = i+1; j < start; ++j)
-				if (m[size()*order[i] + order[j]]
-					!= other.m[size()*f[order[i]] + f[order[j]]])
+				if (m.test(order[i], order[j]) != other.m.test(f[order[i]], f[order[j]]))
 					return false;
 	}
+
+	/* The adjacencies are compared in the backtrack order: bit p of row v of ordered is
+	 * whether v is adjacent to order[p] and bit p of row w of otherOrdered is whether w
+	 * is adjacent to f[order[p]] (only the bits of the positions already mapped are
+	 * meaningful), so that checking a candidate image is a masked row comparison
+	 */
+	bitMatrix ordered(size()), otherOrdered(size());
+	for (unsigned long p = 0; p < size(); ++p)
+		ordered.setColumn(p, m.row(order[p]));
+	for (unsigned long p = 0; p < start; ++p)
+		otherOrdered.setColumn(p, other.m.row(f[order[p]]));
+
+	/* Colour refinement block: the vertices already mapped get the same distinct colour
+	 * as their images and the colourings are refined (see Canonical::refinedPair);
+	 * colours[p] and otherColours[p] are the refinements with the vertices of the
+	 * positions below p individualized, and a vertex may only be mapped to a vertex of
+	 * its colour
+	 */
+	vector< vector<unsigned long> > colours(size() + 1), otherColours(size() + 1);
+	/* Initial colouring block */ {
+		vector<unsigned long> seed(size()), otherSeed(size());
+		for (unsigned long p = 0; p < start; ++p)
+			seed[order[p]] = otherSeed[f[order[p]]] = p + 1;
+		if (!Canonical::refinedPair(m, m, seed, other.m, other.m, otherSeed,
+									colours[start], otherColours[start]))
+			return false;
+		for (unsigned long p = 0; p < start; ++p)
+			if (colours[start][order[p]] != otherColours[start][f[order[p]]])
+				return false;
+	}
  
     /* Isomorphism completion block */ {
 		unsigned long index;
@@ -168,16 +228,12 @@ bool Graph::completeIsomorphism(const Graph& other, morphism& f) const {
 					break;
 				}
 				const unsigned long image(candidates[thisind].first);
-				const unsigned long vLine(v * size());
-				const unsigned long imageLine(image * size());
-				unsigned long morphind;
-				for (morphind = 0; morphind < index; ++morphind)
-					if (m[vLine + order[morphind]]
-						!= other.m[imageLine + f[order[morphind]]])
-						break;
-				if (morphind == index) {
+				if (otherColours[index][image] == colours[index][v] &&
+					ordered.rowsAgree(v, otherOrdered, image, index) &&
+					refineAssignment(other, v, image, index, colours, otherColours)) {
 					candidates[thisind].second = false;
 					f[v] = image;
+					otherOrdered.setColumn(index, other.m.row(image));
 					++index;
 					break;
 				}
@@ -213,58 +269,128 @@ bool Graph::operator!=(const Graph& other) const {
 	return !operator==(other);
 }
 
+/* certificate(morphism* pm) const:
+ * returns: the certificate of the graph (two graphs have equal certificates iff they
+ *          are isomorphic)
+ * note: if pm is not null, the canonical labelling is put on *pm
+ */
+Canonical::certificate_t Graph::certificate(morphism* pm) const {
+	return certificate(vector<unsigned long>(s), pm);
+}
+
+/* certificate(const vector<unsigned long>& colours, morphism* pm) const:
+ * restrictions: colours.size() == size()
+ * returns: the certificate of the graph with vertex v coloured colours[v] (two coloured
+ *          graphs have equal certificates iff there is a colour preserving isomorphism
+ *          between them)
+ * note: if pm is not null, the canonical labelling is put on *pm
+ */
+Canonical::certificate_t Graph::certificate(const vector<unsigned long>& colours,
+											morphism* pm) const {
+	morphism lab;
+	Canonical::certificate_t ret(Canonical::canonicalLabelling(m, m, colours, lab));
+	if (pm)
+		pm->swap(lab);
+	return ret;
+}
+
+/* canonicalForm() const:
+ * returns: the graph isomorphic to *this with the canonical labelling
+ */
+Graph Graph::canonicalForm() const {
+	morphism lab;
+	certificate(&lab);
+	Graph ret;
+	ret.s = s;
+	ret.m = Canonical::relabelled(m, lab);
+	return ret;
+}
+
 /* degree(unsigned long v) const:
  * restrictions: v < size()
  * returns: degree of vertex v
  */
 unsigned long Graph::degree(unsigned long v) const {
-	unsigned long ret(0), line(v*size()), upper(line+size());
-	for (unsigned long i = line; i < upper; ++i)
-		if (m[i])
-			++ret;
-	return ret;
+	return m.rowCount(v);
+}
+
+/* canonicalAugmentation(const bitMatrix& m, Canonical::certificate_t& cert):
+ * auxiliary function of enumerate: the canonical new vertex of a graph is the vertex of
+ * largest canonical label among the vertices of the last class of the refined colouring
+ * (which have maximum degree)
+ * returns: true, iff the last vertex of the graph of adjacency matrix m is in the orbit
+ *          of its canonical new vertex (and then cert is the certificate of the graph)
+ */
+static bool canonicalAugmentation(const bitMatrix& m, Canonical::certificate_t& cert) {
+	const unsigned long n(m.size()), v(n - 1);
+	const vector<unsigned long> none(n);
+	const vector<unsigned long> colours(Canonical::refinedColours(m, m, none));
+	const unsigned long last(*max_element(colours.begin(), colours.end()));
+	if (colours[v] != last)
+		return false;
+
+	vector<unsigned long> lab;
+	cert = Canonical::canonicalLabelling(m, m, none, lab);
+	unsigned long w(v);
+	for (unsigned long x = 0; x < n; ++x)
+		if (colours[x] == last && lab[x] > lab[w])
+			w = x;
+	if (w == v)
+		return true;
+	// v and w are in the same orbit iff individualizing either gives the same certificate
+	vector<unsigned long> vMarked(n), wMarked(n);
+	vMarked[v] = wMarked[w] = 1;
+	return Canonical::canonicalLabelling(m, m, vMarked, lab)
+		== Canonical::canonicalLabelling(m, m, wMarked, lab);
 }
 
 /* enumerate(unsigned long size):
  * returns: container with every graph of size size occurring exactly once
+ * note: uses canonical augmentation: the graphs are the graphs of
+ *       enumerateObjects<Graph>(size - 1) with a new vertex of every neighbourhood that
+ *       is in the orbit of the canonical new vertex (see canonicalAugmentation), so each
+ *       graph is only generated from the class of the graph without that vertex (the
+ *       certificates only have to be compared among the children of the same parent,
+ *       which are repeated by the automorphisms of the parent)
  */
 container<Graph> Graph::enumerate(unsigned long size) {
-	vector<vbool> mat(size, vbool(size));
-	vector<unsigned long> degrees(size);
-	container<Graph> ret(1, Graph(mat));
-
-	while (true) {
-		unsigned long inci(0), incj(0);
-		for ( ; inci < size; ++inci) {
-			for (incj = inci+1; incj < size; ++incj) {
-				if (!mat[inci][incj])
+	if (!size)
+		return container<Graph>(1, Graph());
+
+	const container<Graph>& parents(enumerateObjects<Graph>(size - 1));
+	const unsigned long v(size - 1);
+	container<Graph> ret;
+	vector<unsigned long> deg(v);
+	Graph G;
+	G.s = size;
+	for (unsigned long i = 0; i < parents.size(); ++i) {
+		const Graph& P(parents[i]);
+		G.m = bitMatrix(size);
+		for (unsigned long x = 0; x < v; ++x) {
+			deg[x] = P.degree(x);
+			for (unsigned long y = 0; y < v; ++y)
+				G.m.set(x, y, P.m.test(x, y));
+		}
+		// certificates of the children of P
+		unordered_set<Canonical::certificate_t, Canonical::certificateHash> found;
+		Canonical::certificate_t cert;
+		for (unsigned long nb = 0; nb < (1UL << v); ++nb) {
+			// the new vertex must have maximum degree
+			const unsigned long d(__builtin_popcountl(nb));
+			unsigned long x(0);
+			for ( ; x < v; ++x)
+				if (deg[x] + ((nb >> x) & 1) > d)
 					break;
-				mat[inci][incj] = mat[incj][inci] = false;
-				--degrees[inci];
-				--degrees[incj];
+			if (x < v)
+				continue;
+
+			for (x = 0; x < v; ++x) {
+				G.m.set(v, x, (nb >> x) & 1);
+				G.m.set(x, v, (nb >> x) & 1);
 			}
-			if (incj < size)
-				break;
+			if (canonicalAugmentation(G.m, cert) && found.insert(cert).second)
+				ret.push_back(G);
 		}
-		if (inci == size)
-			break;
-		++degrees[inci];
-		++degrees[incj];
-	
-		mat[inci][incj] = mat[incj][inci] = true;
-
-		unsigned long index;
-		for (index = 1; index < size; ++index)
-			if (degrees[index-1] < degrees[index])
-				break;
-		if (index < size)
-			continue;
-		Graph G(mat);
-		for (index = 0; index < ret.size(); ++index)
-			if (G == ret[index])
-				break;
-		if (index == ret.size())
-			ret.push_back(G);
 	}
 	return ret;
 }
@@ -290,11 +416,12 @@ The vertices of the graph are labeled in 0..n-1
 int Graph::readFromFile(FILE *f) {
 	if (fscanf(f, " (%lu", &s) != 1)
 		return -1;
-	m.assign(s*s, false);
+	m = bitMatrix(s);
 	unsigned long a, b;
 	int ret;
 	while ((ret = fscanf(f, "%lu %lu", &a, &b)) == 2) {
-		m[a*s + b] = m[b*s + a] = true;
+		m.set(a, b);
+		m.set(b, a);
 	}
 	if (ret != 0)
 		return -1;
@@ -310,7 +437,7 @@ void Graph::writeOnFile(FILE *f) const {
 	fprintf(f, "(%lu\n", s);
 	for (unsigned long i = 0; i < s; ++i)
 		for (unsigned long j = i+1; j < s; ++j)
-			if (m[i*s + j])
+			if (m.test(i, j))
 				fprintf(f, "%lu %lu\n", i, j);
 	fprintf(f, ")");
 }
@@ -1,8 +1,11 @@
 #include "FlagTournament.h"
 
 #include <algorithm>
+#include <thread>
+#include <unordered_set>
 
 using namespace FlagAlgebra;
+using namespace BitMatrix;
 using namespace std;
 
 /* default constructor
@@ -91,65 +94,151 @@ bool Tournament::operator!=(const Tournament& other) const {
 	return !operator==(other);
 }
 
-/* enumerate(unsigned long size):
- * returns: container with every tournament of size size occurring exactly once
+/* certificate(morphism* pm) const:
+ * returns: the certificate of the tournament (two tournaments have equal certificates
+ *          iff they are isomorphic)
+ * note: if pm is not null, the canonical labelling is put on *pm
  */
-container<Tournament> Tournament::enumerate(unsigned long size) {
-	vector<vbool> mat(size, vbool(size));
-	for (unsigned long i = 1; i < size; ++i)
-		for (unsigned long j = 0; j < i; ++j)
-			mat[i][j] = true;
-	vector<unsigned long> inDegrees(size), outDegrees(size);
-	for (unsigned long i = 0; i < size; ++i) {
-		inDegrees[i] = size-i-1;
-		outDegrees[i] = i;
-	}
-	
-	container<Tournament> ret(1, Tournament(mat));
-
-	while (true) {
-		unsigned long inci(0), incj(0);
-		for ( ; inci < size; ++inci) {
-			for (incj = inci+1; incj < size; ++incj) {
-				if (!mat[inci][incj])
-					break;
-				mat[inci][incj] = false;
-				mat[incj][inci] = true;
-				--outDegrees[inci];
-				--inDegrees[incj];
-				++inDegrees[inci];
-				++outDegrees[incj];
+Canonical::certificate_t Tournament::certificate(morphism* pm) const {
+	return Digraph::certificate(pm);
+}
+
+/* certificate(const vector<unsigned long>& colours, morphism* pm) const:
+ * restrictions: colours.size() == size()
+ * returns: the certificate of the tournament with vertex v coloured colours[v] (two
+ *          coloured tournaments have equal certificates iff there is a colour preserving
+ *          isomorphism between them)
+ * note: if pm is not null, the canonical labelling is put on *pm
+ */
+Canonical::certificate_t Tournament::certificate(const vector<unsigned long>& colours,
+												 morphism* pm) const {
+	return Digraph::certificate(colours, pm);
+}
+
+/* canonicalForm() const:
+ * returns: the tournament isomorphic to *this with the canonical labelling
+ */
+Tournament Tournament::canonicalForm() const {
+	return Tournament(Digraph::canonicalForm());
+}
+
+/* canonicalAugmentation(const bitMatrix& m,
+ *                       const bitMatrix& t,
+ *                       Canonical::certificate_t& cert):
+ * auxiliary function of enumerate: the canonical new vertex of a tournament is the
+ * vertex of largest canonical label among the vertices of the last class of the refined
+ * colouring (which have maximum out-degree)
+ * returns: true, iff the last vertex of the tournament of adjacency matrix m (and
+ *          transposed t) is in the orbit of its canonical new vertex (and then cert is the
+ *          certificate of the tournament)
+ */
+static bool canonicalAugmentation(const bitMatrix& m,
+								  const bitMatrix& t,
+								  Canonical::certificate_t& cert) {
+	const unsigned long n(m.size()), v(n - 1);
+	const vector<unsigned long> none(n);
+	const vector<unsigned long> colours(Canonical::refinedColours(m, t, none));
+	const unsigned long last(*max_element(colours.begin(), colours.end()));
+	if (colours[v] != last)
+		return false;
+
+	vector<unsigned long> lab;
+	cert = Canonical::canonicalLabelling(m, t, none, lab);
+	unsigned long w(v);
+	for (unsigned long x = 0; x < n; ++x)
+		if (colours[x] == last && lab[x] > lab[w])
+			w = x;
+	if (w == v)
+		return true;
+	// v and w are in the same orbit iff individualizing either gives the same certificate
+	vector<unsigned long> vMarked(n), wMarked(n);
+	vMarked[v] = wMarked[w] = 1;
+	return Canonical::canonicalLabelling(m, t, vMarked, lab)
+		== Canonical::canonicalLabelling(m, t, wMarked, lab);
+}
+
+/* augmentParents(const container<Tournament>* parents,
+ *                unsigned long first,
+ *                unsigned long step,
+ *                vector< mcont<Tournament> >* children):
+ * auxiliary function of enumerate (run by each of its threads): for the parents of
+ * indexes first, first + step, first + 2 step, ..., makes (*children)[i] be the
+ * tournaments of one more vertex obtained from (*parents)[i] (see enumerate)
+ */
+void Tournament::augmentParents(const container<Tournament>* parents,
+								unsigned long first,
+								unsigned long step,
+								vector< mcont<Tournament> >* children) {
+	const unsigned long v((*parents)[0].size()), size(v + 1);
+	vector<unsigned long> score(v);
+	Tournament T;
+	T.s = size;
+	for (unsigned long i = first; i < parents->size(); i += step) {
+		const Tournament& P((*parents)[i]);
+		T.m = bitMatrix(size);
+		T.t = bitMatrix(size);
+		for (unsigned long x = 0; x < v; ++x) {
+			score[x] = P.outDegree(x);
+			for (unsigned long y = 0; y < v; ++y) {
+				T.m.set(x, y, P.m.test(x, y));
+				T.t.set(x, y, P.t.test(x, y));
 			}
-			if (incj < size)
-				break;
 		}
-		if (inci == size)
-			break;
-		++outDegrees[inci];
-		++inDegrees[incj];
-		--inDegrees[inci];
-		--outDegrees[incj];
-
-		mat[inci][incj] = true;
-		mat[incj][inci] = false;
-
-		unsigned long index;
-		for (index = 1; index < size; ++index) {
-			if (outDegrees[index-1] < outDegrees[index])
-				break;
-			else if (outDegrees[index-1] == outDegrees[index]
-					 && inDegrees[index-1] < inDegrees[index])
-				break;
+		// certificates of the children of P
+		unordered_set<Canonical::certificate_t, Canonical::certificateHash> found;
+		Canonical::certificate_t cert;
+		for (unsigned long out = 0; out < (1UL << v); ++out) {
+			// the new vertex must have maximum score (x gains a point if it beats it)
+			const unsigned long d(__builtin_popcountl(out));
+			unsigned long x(0);
+			for ( ; x < v; ++x)
+				if (score[x] + !((out >> x) & 1) > d)
+					break;
+			if (x < v)
+				continue;
+
+			for (x = 0; x < v; ++x) {
+				const bool arc((out >> x) & 1);
+				T.m.set(v, x, arc);
+				T.m.set(x, v, !arc);
+				T.t.set(x, v, arc);
+				T.t.set(v, x, !arc);
+			}
+			if (canonicalAugmentation(T.m, T.t, cert) && found.insert(cert).second)
+				(*children)[i].push_back(T);
 		}
-		if (index < size)
-			continue;
-
-		Tournament T(mat);
-		for (index = 0; index < ret.size(); ++index)
-			if (T == ret[index])
-				break;
-		if (index == ret.size())
-			ret.push_back(T);
+	}
+}
+
+/* enumerate(unsigned long size):
+ * returns: container with every tournament of size size occurring exactly once
+ * note: uses canonical augmentation: the tournaments are the tournaments of
+ *       enumerateObjects<Tournament>(size - 1) with a new vertex of every
+ *       out-neighbourhood that is in the orbit of the canonical new vertex (see
+ *       canonicalAugmentation), so each tournament is only generated from the class of
+ *       the tournament without that vertex (the certificates only have to be compared
+ *       among the children of the same parent, which are repeated by the automorphisms of
+ *       the parent); the parents are split among threadCount threads and the
+ *       result is in the order of the parents
+ */
+container<Tournament> Tournament::enumerate(unsigned long size) {
+	if (!size)
+		return container<Tournament>(1, Tournament());
+
+	const container<Tournament>& parents(enumerateObjects<Tournament>(size - 1));
+	vector< mcont<Tournament> > children(parents.size());
+	const unsigned long threads(threadCount(parents.size()));
+	vector<thread> pool;
+	for (unsigned long k = 1; k < threads; ++k)
+		pool.push_back(thread(augmentParents, &parents, k, threads, &children));
+	augmentParents(&parents, 0, threads, &children);
+	for (unsigned long k = 0; k < pool.size(); ++k)
+		pool[k].join();
+
+	container<Tournament> ret;
+	for (unsigned long i = 0; i < children.size(); ++i) {
+		ret.insert(ret.end(), children[i].begin(), children[i].end());
+		mcont<Tournament>().swap(children[i]);
 	}
 	return ret;
 }
@@ -0,0 +1,379 @@
+#include "Canonical.h"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+using namespace Canonical;
+using namespace BitMatrix;
+using namespace std;
+
+std::size_t certificateHash::operator()(const certificate_t& c) const {
+	word_t h(c.size());
+	for (certificate_t::const_iterator it = c.begin(); it != c.end(); ++it) {
+		h = (h ^ *it) * 0x9e3779b97f4a7c15ULL;
+		h ^= h >> 32;
+	}
+	return static_cast<std::size_t>(h);
+}
+
+/* countMasked(const word_t* row, const word_t* mask, unsigned long w):
+ * returns: number of bits set in both of the w words of row and of mask
+ */
+static unsigned long countMasked(const word_t *row, const word_t *mask, unsigned long w) {
+	unsigned long ret(0);
+	for (unsigned long l = 0; l < w; ++l)
+		ret += __builtin_popcountll(row[l] & mask[l]);
+	return ret;
+}
+
+// This is an auxiliary class to sort the vertices by their signatures (see refine)
+class compSignature {
+public:
+	compSignature(const vector<unsigned long>& sig, unsigned long stride)
+		: sig(sig), stride(stride) {}
+	bool operator()(unsigned long a, unsigned long b) const {
+		return lexicographical_compare(sig.begin() + a * stride,
+									   sig.begin() + (a + 1) * stride,
+									   sig.begin() + b * stride,
+									   sig.begin() + (b + 1) * stride);
+	}
+	bool equal(unsigned long a, unsigned long b) const {
+		return std::equal(sig.begin() + a * stride,
+						  sig.begin() + (a + 1) * stride,
+						  sig.begin() + b * stride);
+	}
+private:
+	const vector<unsigned long>& sig;
+	unsigned long stride;
+};
+
+/* normalize(vector<unsigned long>& c):
+ * replaces the colours of c by their ranks among the colours of c (keeping their order)
+ * returns: the number of distinct colours
+ */
+static unsigned long normalize(vector<unsigned long>& c) {
+	vector<unsigned long> values(c);
+	sort(values.begin(), values.end());
+	values.erase(unique(values.begin(), values.end()), values.end());
+	for (unsigned long v = 0; v < c.size(); ++v)
+		c[v] = lower_bound(values.begin(), values.end(), c[v]) - values.begin();
+	return values.size();
+}
+
+/* refine(const bitMatrix& out, const bitMatrix& in, vector<unsigned long>& c):
+ * restrictions: c has ranks as colours (see normalize)
+ * refines c until every two vertices of the same colour have the same multisets of
+ * colours of out-neighbours and of in-neighbours (in is not looked at if it is the
+ * same object as out)
+ * note: the colours are ranks of the signatures (old colour, number of out-neighbours
+ *       of each colour, number of in-neighbours of each colour), so the refinement
+ *       doesn't depend on the labels; the numbers are popcounts of the rows masked by
+ *       the colour classes
+ */
+static void refine(const bitMatrix& out, const bitMatrix& in, vector<unsigned long>& c) {
+	const unsigned long n(c.size());
+	if (!n)
+		return;
+	const bool symmetric(&out == &in);
+	const unsigned long w(out.wordsPerRow());
+	unsigned long cells(*max_element(c.begin(), c.end()) + 1);
+
+	vector<word_t> masks;
+	vector<unsigned long> sig, byRank(n);
+	while (cells < n) {
+		masks.assign(cells * w, 0);
+		for (unsigned long v = 0; v < n; ++v)
+			masks[c[v] * w + v / bitsWord] |= word_t(1) << (v % bitsWord);
+
+		const unsigned long stride(1 + (symmetric? 1 : 2) * cells);
+		sig.resize(n * stride);
+		for (unsigned long v = 0; v < n; ++v) {
+			unsigned long *p(&sig[v * stride]);
+			*p++ = c[v];
+			for (unsigned long k = 0; k < cells; ++k)
+				*p++ = countMasked(out.row(v), &masks[k * w], w);
+			if (!symmetric)
+				for (unsigned long k = 0; k < cells; ++k)
+					*p++ = countMasked(in.row(v), &masks[k * w], w);
+			byRank[v] = v;
+		}
+		compSignature comp(sig, stride);
+		sort(byRank.begin(), byRank.end(), comp);
+		unsigned long newCells(0);
+		for (unsigned long i = 0; i < n; ++i) {
+			if (i && !comp.equal(byRank[i], byRank[i-1]))
+				++newCells;
+			c[byRank[i]] = newCells;
+		}
+		if (++newCells == cells)
+			break;
+		cells = newCells;
+	}
+}
+
+/* refinedColours(const bitMatrix& out,
+ *                const bitMatrix& in,
+ *                const vector<unsigned long>& colours):
+ * restrictions: in is out transposed (or the same object as out, if it is symmetric)
+ *               colours.size() == out.size()
+ * returns: the coarsest refinement of colours in which every two vertices of the same
+ *          colour have the same numbers of out-neighbours and of in-neighbours of each
+ *          colour (colour refinement, or 1-dimensional Weisfeiler-Leman)
+ * note: the colours returned are 0, 1, ..., and are ordered first by the given colours,
+ *       so that isomorphisms preserving colours also preserve the refined ones
+ */
+vector<unsigned long> Canonical::refinedColours(const bitMatrix& out,
+												const bitMatrix& in,
+												const vector<unsigned long>& colours) {
+	vector<unsigned long> c(colours);
+	normalize(c);
+	refine(out, in, c);
+	return c;
+}
+
+/* refinedPair(const bitMatrix& out,
+ *             const bitMatrix& in,
+ *             const vector<unsigned long>& colours,
+ *             const bitMatrix& otherOut,
+ *             const bitMatrix& otherIn,
+ *             const vector<unsigned long>& otherColours,
+ *             vector<unsigned long>& refined,
+ *             vector<unsigned long>& otherRefined):
+ * restrictions: as in refinedColours for both matrices
+ * makes refined and otherRefined be the refinements of colours and otherColours (see
+ * refinedColours)
+ * returns: false, if the refined colourings have different numbers of vertices of some
+ *          colour (and then there is no isomorphism from out to otherOut that preserves
+ *          the given colours)
+ * note: every isomorphism that preserves the given colours also preserves the refined
+ *       ones, so only vertices of the same refined colour can be mapped to each other
+ */
+bool Canonical::refinedPair(const bitMatrix& out,
+							const bitMatrix& in,
+							const vector<unsigned long>& colours,
+							const bitMatrix& otherOut,
+							const bitMatrix& otherIn,
+							const vector<unsigned long>& otherColours,
+							vector<unsigned long>& refined,
+							vector<unsigned long>& otherRefined) {
+	refined = refinedColours(out, in, colours);
+	otherRefined = refinedColours(otherOut, otherIn, otherColours);
+	vector<unsigned long> cellSize(refined.size()), otherCellSize(otherRefined.size());
+	for (unsigned long v = 0; v < refined.size(); ++v) {
+		++cellSize[refined[v]];
+		++otherCellSize[otherRefined[v]];
+	}
+	return cellSize == otherCellSize;
+}
+
+/* relabelled(const bitMatrix& m, const vector<unsigned long>& lab):
+ * restrictions: lab is a permutation of 0, ..., m.size() - 1
+ * returns: the matrix that has bit (lab[i], lab[j]) set iff m has bit (i, j) set
+ */
+bitMatrix Canonical::relabelled(const bitMatrix& m, const vector<unsigned long>& lab) {
+	bitMatrix ret(m.size());
+	for (unsigned long i = 0; i < m.size(); ++i) {
+		const word_t *row(m.row(i));
+		for (unsigned long l = 0; l < m.wordsPerRow(); ++l)
+			for (word_t word(row[l]); word; word &= word - 1)
+				ret.set(lab[i], lab[l * bitsWord + __builtin_ctzll(word)]);
+	}
+	return ret;
+}
+
+// Level returned by the search when it need not go back
+static const unsigned long noJump(numeric_limits<unsigned long>::max());
+
+/* struct searchState keeps the state of the search tree of canonicalLabelling: each
+ * node individualizes a vertex of the first non-singleton cell of the refined colouring
+ * of its parent, and the leaves (discrete colourings) are labellings, of which the one
+ * with the least certificate is the canonical one
+ * The tree is pruned by the automorphisms found (the leaves with certificates equal to
+ * the first or to the best one): the children of a node that are in the same orbit
+ * of the automorphisms that fix the path to the node have equivalent subtrees, and
+ * an automorphism to the first leaf makes the whole subtree equivalent to the first
+ * one, back to where the paths split
+ */
+struct searchState {
+	const bitMatrix &out, &in;
+	const vector<unsigned long>& colours;
+	vector<unsigned long> path, firstPath;
+	vector<unsigned long> firstLab, bestLab, firstInverse;
+	certificate_t firstCert, bestCert;
+	vector< vector<unsigned long> > automorphisms;
+
+	searchState(const bitMatrix& o, const bitMatrix& i, const vector<unsigned long>& c)
+		: out(o), in(i), colours(c) {}
+
+	certificate_t leafCertificate(const vector<unsigned long>&) const;
+	bool sameOrbit(unsigned long, const vector<unsigned long>&) const;
+	void addAutomorphism(const vector<unsigned long>&, const vector<unsigned long>&);
+	unsigned long search(const vector<unsigned long>&);
+};
+
+/* leafCertificate(const vector<unsigned long>& lab) const:
+ * returns: the certificate of the labelling lab (the size, the given colours in the new
+ *          order and the words of the relabelled matrix)
+ */
+certificate_t searchState::leafCertificate(const vector<unsigned long>& lab) const {
+	const unsigned long n(lab.size());
+	certificate_t ret;
+	ret.reserve(1 + n + n * bitMatrix::words(n));
+	ret.push_back(n);
+	ret.resize(1 + n);
+	for (unsigned long v = 0; v < n; ++v)
+		ret[1 + lab[v]] = colours[v];
+	const bitMatrix m(relabelled(out, lab));
+	for (unsigned long i = 0; i < n; ++i)
+		ret.insert(ret.end(), m.row(i), m.row(i) + m.wordsPerRow());
+	return ret;
+}
+
+/* sameOrbit(unsigned long w, const vector<unsigned long>& tried) const:
+ * returns: true, iff w is in the orbit of some vertex of tried under the group
+ *          generated by the automorphisms found that fix every vertex of path
+ */
+bool searchState::sameOrbit(unsigned long w, const vector<unsigned long>& tried) const {
+	if (tried.empty() || automorphisms.empty())
+		return false;
+	const unsigned long n(colours.size());
+	vector<unsigned long> parent(n);
+	for (unsigned long v = 0; v < n; ++v)
+		parent[v] = v;
+	for (unsigned long a = 0; a < automorphisms.size(); ++a) {
+		const vector<unsigned long>& g(automorphisms[a]);
+		unsigned long p;
+		for (p = 0; p < path.size(); ++p)
+			if (g[path[p]] != path[p])
+				break;
+		if (p < path.size())
+			continue;
+		for (unsigned long v = 0; v < n; ++v) {
+			unsigned long r1(v), r2(g[v]);
+			while (parent[r1] != r1)
+				r1 = parent[r1];
+			while (parent[r2] != r2)
+				r2 = parent[r2];
+			if (r1 != r2)
+				parent[max(r1, r2)] = min(r1, r2);
+		}
+	}
+	unsigned long rw(w);
+	while (parent[rw] != rw)
+		rw = parent[rw];
+	for (unsigned long t = 0; t < tried.size(); ++t) {
+		unsigned long rt(tried[t]);
+		while (parent[rt] != rt)
+			rt = parent[rt];
+		if (rt == rw)
+			return true;
+	}
+	return false;
+}
+
+/* addAutomorphism(const vector<unsigned long>& lab, const vector<unsigned long>& inverse):
+ * records the automorphism that takes each vertex v to the vertex that inverse puts
+ * where lab puts v
+ */
+void searchState::addAutomorphism(const vector<unsigned long>& lab,
+								  const vector<unsigned long>& inverse) {
+	vector<unsigned long> g(lab.size());
+	for (unsigned long v = 0; v < lab.size(); ++v)
+		g[v] = inverse[lab[v]];
+	automorphisms.push_back(g);
+}
+
+/* search(const vector<unsigned long>& c):
+ * restrictions: c is refined (see refine)
+ * explores the subtree of the node of path with colouring c
+ * returns: the level the search must go back to (noJump, if none)
+ */
+unsigned long searchState::search(const vector<unsigned long>& c) {
+	const unsigned long n(c.size());
+	vector<unsigned long> cellSize(n);
+	for (unsigned long v = 0; v < n; ++v)
+		++cellSize[c[v]];
+	unsigned long target(0);
+	while (target < n && cellSize[target] <= 1)
+		++target;
+
+	if (target == n) {
+		// Leaf: the colours are the positions
+		certificate_t cert(leafCertificate(c));
+		if (firstCert.empty()) {
+			firstPath = path;
+			firstLab = bestLab = c;
+			firstInverse.resize(n);
+			for (unsigned long v = 0; v < n; ++v)
+				firstInverse[c[v]] = v;
+			firstCert = bestCert = cert;
+			return noJump;
+		}
+		if (cert == firstCert) {
+			addAutomorphism(c, firstInverse);
+			unsigned long level(0);
+			while (level < path.size() && path[level] == firstPath[level])
+				++level;
+			return level;
+		}
+		if (cert == bestCert) {
+			vector<unsigned long> bestInverse(n);
+			for (unsigned long v = 0; v < n; ++v)
+				bestInverse[bestLab[v]] = v;
+			addAutomorphism(c, bestInverse);
+		}
+		else if (cert < bestCert) {
+			bestCert.swap(cert);
+			bestLab = c;
+		}
+		return noJump;
+	}
+
+	const unsigned long level(path.size());
+	vector<unsigned long> tried;
+	for (unsigned long w = 0; w < n; ++w) {
+		if (c[w] != target || sameOrbit(w, tried))
+			continue;
+		tried.push_back(w);
+		// w goes before the other vertices of its cell
+		vector<unsigned long> child(c);
+		for (unsigned long v = 0; v < n; ++v)
+			child[v] = 2 * child[v] + (v != w);
+		normalize(child);
+		refine(out, in, child);
+		path.push_back(w);
+		const unsigned long jump(search(child));
+		path.pop_back();
+		if (jump < level)
+			return jump;
+	}
+	return noJump;
+}
+
+/* canonicalLabelling(const bitMatrix& out,
+ *                    const bitMatrix& in,
+ *                    const vector<unsigned long>& colours,
+ *                    vector<unsigned long>& lab):
+ * restrictions: in is out transposed (or the same object as out, if it is symmetric)
+ *               colours.size() == out.size()
+ * makes lab be the canonical labelling of the matrix out with vertex colours colours
+ * (lab[v] is the new index of v; vertices are ordered first by their colours)
+ * returns: the certificate of out with colours
+ * note: uses partition refinement and individualization (the search tree of McKay's
+ *       canonical labelling, pruned by the automorphisms found)
+ */
+certificate_t Canonical::canonicalLabelling(const bitMatrix& out,
+											const bitMatrix& in,
+											const vector<unsigned long>& colours,
+											vector<unsigned long>& lab) {
+	searchState state(out, in, colours);
+	state.search(refinedColours(out, in, colours));
+	lab = state.bestLab;
+	return state.bestCert;
+}
+
+/* Local Variables: */
+/* mode: c++ */
+/* tab-width: 4 */
+/* End: */
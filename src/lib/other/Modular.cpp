@@ -0,0 +1,265 @@
+#include "Modular.h"
+
+#include <algorithm>
+
+using namespace Modular;
+using namespace BigNum;
+using namespace std;
+
+/* montgomeryReduce(uint64_t t, residue_t p, residue_t negInv):
+ * restrictions: p is odd and below 2^31, negInv * p = -1 (mod 2^32) and t < p 2^32
+ * returns: t / 2^32 (mod p), in the range [0, p)
+ */
+static inline residue_t montgomeryReduce(uint64_t t, residue_t p, residue_t negInv) {
+	const residue_t m(static_cast<residue_t>(t) * negInv);
+	// t + m p < 2 p 2^32 <= 2^64 and is a multiple of 2^32
+	const residue_t r(static_cast<residue_t>((t + static_cast<uint64_t>(m) * p) >> 32));
+	return r >= p? r - p : r;
+}
+
+/* isPrime(residue_t n):
+ * returns: true, iff n is prime (by trial division, which is enough below 2^31)
+ */
+static bool isPrime(residue_t n) {
+	if (n < 2)
+		return false;
+	if (!(n % 2))
+		return n == 2;
+	for (residue_t d = 3; d <= n / d; d += 2)
+		if (!(n % d))
+			return false;
+	return true;
+}
+
+/* primeSet(unsigned long n):
+ * makes a set with the n largest primes below 2^31
+ */
+primeSet::primeSet(unsigned long n) : prods(1, bn1) {
+	while (n--)
+		addPrime();
+}
+
+unsigned long primeSet::size() const {
+	return primes.size();
+}
+
+/* product() const:
+ * returns: the product of the primes of the set
+ */
+const bignum& primeSet::product() const {
+	return prods.back();
+}
+
+/* product(unsigned long count) const:
+ * restrictions: count <= size()
+ * returns: the product of the first count primes of the set
+ */
+const bignum& primeSet::product(unsigned long count) const {
+	return prods[count];
+}
+
+/* addPrime():
+ * adds to the set the largest prime below 2^31 that is smaller than all primes of the
+ * set
+ * note: the residue vectors obtained before the prime is added are no longer valid
+ */
+void primeSet::addPrime() {
+	residue_t p(primes.empty()? 0x7fffffffU : primes.back() - 2);
+	while (!isPrime(p))
+		p -= 2;
+
+	residue_t inverse(p);
+	for (int i = 0; i < 4; ++i)
+		inverse *= 2 - p * inverse;
+	const uint64_t r(((uint64_t(1) << 32) % p));
+
+	primes.push_back(p);
+	negInverses.push_back(0 - inverse);
+	squaredRs.push_back(static_cast<residue_t>(r * r % p));
+
+	// Inverse of the product of the previous primes (in ordinary form)
+	const unsigned long last(primes.size() - 1);
+	const residue_t prodMont(reduce(uint64_t(prods.back().residue(p)) * squaredRs[last],
+									last));
+	garnerInverses.push_back(reduce(power(prodMont, p - 2, last), last));
+	prods.push_back(prods.back() * bignum(static_cast<long>(p)));
+}
+
+/* fromBignum(const BigNum::bignum& n, residue_t* r):
+ * restrictions: r points to size() residues
+ * makes r be the residue vector of n
+ */
+void primeSet::fromBignum(const bignum& n, residue_t *r) const {
+	for (unsigned long i = 0; i < primes.size(); ++i)
+		r[i] = reduce(uint64_t(n.residue(primes[i])) * squaredRs[i], i);
+}
+
+/* fromFrac(const BigNum::frac& f, residue_t* r):
+ * restrictions: r points to size() residues
+ * makes r be the residue vector of f
+ * returns: false, iff some prime of the set divides the denominator of f (in which case
+ *          r is unspecified)
+ */
+bool primeSet::fromFrac(const frac& f, residue_t *r) const {
+	for (unsigned long i = 0; i < primes.size(); ++i) {
+		const residue_t d(static_cast<residue_t>(f.denominator().residue(primes[i])));
+		if (!d)
+			return false;
+		const residue_t n(static_cast<residue_t>(f.numerator().residue(primes[i])));
+		const residue_t dInverse(power(reduce(uint64_t(d) * squaredRs[i], i),
+									   primes[i] - 2,
+									   i));
+		r[i] = reduce(uint64_t(reduce(uint64_t(n) * squaredRs[i], i)) * dInverse, i);
+	}
+	return true;
+}
+
+/* add(residue_t* r, const residue_t* a):
+ * makes r = r + a
+ */
+void primeSet::add(residue_t *r, const residue_t *a) const {
+	const residue_t *p(primes.data());
+	for (unsigned long i = 0, n = primes.size(); i < n; ++i) {
+		const residue_t s(r[i] + a[i]);
+		r[i] = s >= p[i]? s - p[i] : s;
+	}
+}
+
+/* subtract(residue_t* r, const residue_t* a):
+ * makes r = r - a
+ */
+void primeSet::subtract(residue_t *r, const residue_t *a) const {
+	const residue_t *p(primes.data());
+	for (unsigned long i = 0, n = primes.size(); i < n; ++i)
+		r[i] = r[i] >= a[i]? r[i] - a[i] : r[i] + p[i] - a[i];
+}
+
+/* multiply(residue_t* r, const residue_t* a, const residue_t* b):
+ * makes r = a * b (r may be one of a or b)
+ */
+void primeSet::multiply(residue_t *r, const residue_t *a, const residue_t *b) const {
+	const residue_t *p(primes.data()), *ni(negInverses.data());
+	for (unsigned long i = 0, n = primes.size(); i < n; ++i)
+		r[i] = montgomeryReduce(uint64_t(a[i]) * b[i], p[i], ni[i]);
+}
+
+/* addmul(residue_t* r, const residue_t* a, const residue_t* b):
+ * makes r = r + a * b
+ */
+void primeSet::addmul(residue_t *r, const residue_t *a, const residue_t *b) const {
+	const residue_t *p(primes.data()), *ni(negInverses.data());
+	for (unsigned long i = 0, n = primes.size(); i < n; ++i) {
+		const residue_t s(r[i] + montgomeryReduce(uint64_t(a[i]) * b[i], p[i], ni[i]));
+		r[i] = s >= p[i]? s - p[i] : s;
+	}
+}
+
+/* submul(residue_t* r, const residue_t* a, const residue_t* b):
+ * makes r = r - a * b
+ */
+void primeSet::submul(residue_t *r, const residue_t *a, const residue_t *b) const {
+	const residue_t *p(primes.data()), *ni(negInverses.data());
+	for (unsigned long i = 0, n = primes.size(); i < n; ++i) {
+		const residue_t m(montgomeryReduce(uint64_t(a[i]) * b[i], p[i], ni[i]));
+		r[i] = r[i] >= m? r[i] - m : r[i] + p[i] - m;
+	}
+}
+
+/* zero(const residue_t* a) const:
+ * returns: true, iff every residue of a is zero
+ */
+bool primeSet::zero(const residue_t *a) const {
+	for (unsigned long i = 0; i < primes.size(); ++i)
+		if (a[i])
+			return false;
+	return true;
+}
+
+/* agrees(const residue_t* a, const BigNum::frac& f) const:
+ * returns: true, iff a is the residue vector of f (false if some prime of the set
+ *          divides the denominator of f)
+ */
+bool primeSet::agrees(const residue_t *a, const frac& f) const {
+	vector<residue_t> r(primes.size());
+	if (!fromFrac(f, r.data()))
+		return false;
+	return equal(r.begin(), r.end(), a);
+}
+
+/* combine(const residue_t* a, unsigned long count) const:
+ * restrictions: count <= size()
+ * returns: the only integer in [0, product(count)) whose residues modulo the first count
+ *          primes are the ones of a
+ * note: uses Garner's algorithm for the chinese remainder theorem
+ */
+bignum primeSet::combine(const residue_t *a, unsigned long count) const {
+	bignum x, m(bn1);
+	for (unsigned long i = 0; i < count; ++i) {
+		const uint64_t p(primes[i]);
+		const uint64_t ai(reduce(a[i], i)), xi(x.residue(primes[i]));
+		const uint64_t t((ai + p - xi) % p * garnerInverses[i] % p);
+		x.addmul(m, bignum(static_cast<long>(t)));
+		m *= bignum(static_cast<long>(p));
+	}
+	return x;
+}
+
+/* reconstruct(const residue_t* a,
+ *             const BigNum::bignum& numBound,
+ *             const BigNum::bignum& denBound,
+ *             BigNum::frac& f,
+ *             unsigned long count) const:
+ * restrictions: numBound >= 0, denBound > 0 and count <= size()
+ * makes f be the fraction n / d whose residues modulo the first count primes are the
+ * ones of a, with |n| <= numBound and 0 < d <= denBound, if it exists
+ * returns: false, iff no such fraction was found, or the bounds are too large for the
+ *          fraction to be unique (2 numBound denBound >= product(count))
+ * note: uses rational reconstruction (the extended euclidean algorithm is stopped at the
+ *       first remainder that is at most numBound)
+ *       the residues of a modulo the other primes are not used (see agrees)
+ */
+bool primeSet::reconstruct(const residue_t *a,
+						   const bignum& numBound,
+						   const bignum& denBound,
+						   frac& f,
+						   unsigned long count) const {
+	const bignum& prod(prods[count]);
+	if (numBound * denBound * bn2 >= prod)
+		return false;
+	bignum r0(prod), r1(combine(a, count)), t0, t1(bn1);
+	while (r1 > numBound) {
+		divRes dr(divide(r0, r1));
+		r0.swap(r1);
+		r1.swap(dr.second);
+		t0.submul(dr.first, t1);
+		t0.swap(t1);
+	}
+	bignum d(t1);
+	d.removeSignal();
+	if (d.zero() || d > denBound || gcd(r1, d) != bn1)
+		return false;
+	f = frac(r1, t1);
+	return true;
+}
+
+/* reduce(uint64_t t, unsigned long i) const:
+ * returns: the Montgomery reduction of t modulo the i-th prime
+ */
+residue_t primeSet::reduce(uint64_t t, unsigned long i) const {
+	return montgomeryReduce(t, primes[i], negInverses[i]);
+}
+
+/* power(residue_t b, residue_t e, unsigned long i) const:
+ * restrictions: b is in Montgomery form
+ * returns: b to the power e modulo the i-th prime (in Montgomery form)
+ */
+residue_t primeSet::power(residue_t b, residue_t e, unsigned long i) const {
+	// 1 in Montgomery form
+	residue_t r(reduce(squaredRs[i], i));
+	for ( ; e; e /= 2) {
+		if (e % 2)
+			r = reduce(uint64_t(r) * b, i);
+		b = reduce(uint64_t(b) * b, i);
+	}
+	return r;
+}
@@ -1,9 +1,15 @@
 #include "bignum.h"
 
 #include <cctype>
+#include <cmath>
+#include <climits>
+#include <cfloat>
 #include <sstream>
 #include <algorithm>
 #include <deque>
+#include <utility>
+#include <mutex>
+#include <atomic>
 
 using namespace BigNum;
 using namespace std;
@@ -13,6 +19,118 @@ static int isoctal(int c) {
 	return '0' <= c && c < '8';
 }
 
+// Auxiliary base functions
+static unsigned long radix(base b) {
+	switch (b) {
+	case octal:
+		return 8;
+	case decimal:
+		return 10;
+	case hexadecimal:
+		return 16;
+	}
+	return 10; //doesn't happen
+}
+
+// Lock of the tables of memoized values (the tables are filled recursively)
+static std::recursive_mutex memoMutex;
+
+static unsigned long digitValue(int c) {
+	return c - ('0' <= c && c <= '9'? '0' : ('a' <= c && c <= 'f'? 'a' : 'A') - 10);
+}
+
+/* class digitBuffer keeps the digits of a number being read: on the stack for the usual
+ * short numbers and on the heap for the long ones
+ */
+class digitBuffer {
+public:
+	digitBuffer() : n(0) {}
+	void push_back(char c) {
+		if (n < sizeof(local))
+			local[n] = c;
+		else {
+			if (n == sizeof(local))
+				heap.assign(local, n);
+			heap.push_back(c);
+		}
+		++n;
+	}
+	const char* data() const { return n > sizeof(local)? heap.data() : local; }
+	unsigned long size() const { return n; }
+private:
+	char local[128];
+	std::string heap;
+	unsigned long n;
+};
+
+// The overflow-checked arithmetic below uses the compiler builtins when available
+#if defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5)
+#define BIGNUM_OVERFLOW_BUILTINS
+#endif
+
+/* checkedAdd(long a, long b, long& r):
+ * makes r = a + b
+ * returns: false, iff the sum overflows (in which case r is unspecified)
+ */
+static bool checkedAdd(long a, long b, long& r) {
+#ifdef BIGNUM_OVERFLOW_BUILTINS
+	return !__builtin_add_overflow(a, b, &r);
+#else
+	if (b > 0? a > LONG_MAX - b : a < LONG_MIN - b)
+		return false;
+	r = a + b;
+	return true;
+#endif
+}
+
+/* checkedMul(long a, long b, long& r):
+ * makes r = a * b
+ * returns: false, iff the product overflows (in which case r is unspecified)
+ */
+static bool checkedMul(long a, long b, long& r) {
+#ifdef BIGNUM_OVERFLOW_BUILTINS
+	return !__builtin_mul_overflow(a, b, &r);
+#else
+	if (a > 0? (b > 0? a > LONG_MAX / b : b < LONG_MIN / a)
+		: (b > 0? a < LONG_MIN / b : a && b < LONG_MAX / a))
+		return false;
+	r = a * b;
+	return true;
+#endif
+}
+
+/* absolute(long a):
+ * returns: the absolute value of a as an unsigned long (correct for LONG_MIN too)
+ */
+static unsigned long absolute(long a) {
+	return a < 0? 0UL - static_cast<unsigned long>(a) : static_cast<unsigned long>(a);
+}
+
+/* binaryGcd(unsigned long a, unsigned long b):
+ * returns: the greatest common divisor of a and b (computed by the binary algorithm)
+ */
+static unsigned long binaryGcd(unsigned long a, unsigned long b) {
+	if (!a)
+		return b;
+	if (!b)
+		return a;
+	unsigned long shift = 0;
+	for ( ; !((a | b) & 1); ++shift) {
+		a >>= 1;
+		b >>= 1;
+	}
+	while (!(a & 1))
+		a >>= 1;
+	do {
+		while (!(b & 1))
+			b >>= 1;
+		if (a > b)
+			std::swap(a, b);
+		b -= a;
+	} while (b);
+	return a << shift;
+}
+
 // These are useful bignum constants
 const bignum BigNum::bn0(0),
 				BigNum::bn1(1),
@@ -21,65 +139,180 @@ const bignum BigNum::bn0(0),
 				BigNum::bn10(10),
 				BigNum::bn16(16);
 
-const size_t bignum::bitsElem(8);
-const bignum::elem_t bignum::maxElem(255);
+const size_t bignum::bitsElem(sizeof(bignum::elem_t) * CHAR_BIT);
+const bignum::elem_t bignum::maxElem(static_cast<bignum::elem_t>(~bignum::elem_t(0)));
 
-bignum::bignum() : v(), sgn(false) {}
+// Operands with at least these many elements are multiplied (squared) by the
+// Karatsuba and Toom-3 algorithms (the values, in bits, were tuned on 64-bit elements)
+const unsigned long bignum::karatsubaThreshold(2048 / BIGNUM_LIMB_BITS);
+const unsigned long bignum::toom3Threshold(24576 / BIGNUM_LIMB_BITS);
+const unsigned long bignum::karatsubaSqrThreshold(3072 / BIGNUM_LIMB_BITS);
+const unsigned long bignum::toom3SqrThreshold(24576 / BIGNUM_LIMB_BITS);
+// Number of elements below which base conversions are done chunk by chunk
+const unsigned long bignum::fromDigitsThreshold(2048 / BIGNUM_LIMB_BITS);
+const unsigned long bignum::toDigitsThreshold(1024 / BIGNUM_LIMB_BITS);
+
+bignum::elemVector::elemVector(const elemVector& other) : sz(0), cap(inlineElems) {
+	assign(other.data(), other.data() + other.sz);
+}
+
+bignum::elemVector& bignum::elemVector::operator=(const elemVector& other) {
+	if (this != &other)
+		assign(other.data(), other.data() + other.sz);
+	return *this;
+}
+
+bool bignum::elemVector::operator==(const elemVector& other) const {
+	return sz == other.sz && std::equal(data(), data() + sz, other.data());
+}
+
+/* resize(unsigned long n):
+ * makes the size of the vector be n (new elements are 0)
+ */
+void bignum::elemVector::resize(unsigned long n) {
+	if (n > cap)
+		reallocate(n);
+	if (n > sz)
+		std::fill(data() + sz, data() + n, elem_t(0));
+	sz = n;
+}
+
+/* reserve(unsigned long n):
+ * makes the vector have room for at least n elements
+ */
+void bignum::elemVector::reserve(unsigned long n) {
+	if (n > cap)
+		reallocate(n);
+}
+
+void bignum::elemVector::push_back(elem_t e) {
+	if (sz == cap)
+		reallocate(2 * cap);
+	data()[sz++] = e;
+}
 
-bignum::bignum(long n) : v(sizeof(long)), sgn() {
-	if (n < 0) {
-		n = -n;
-		sgn = true;
+/* assign(const elem_t *first, const elem_t *last):
+ * makes the vector hold the elements in [first, last)
+ * restrictions: [first, last) is not inside the vector
+ */
+void bignum::elemVector::assign(const elem_t *first, const elem_t *last) {
+	const unsigned long n(last - first);
+	if (n > cap) {
+		if (cap > inlineElems)
+			delete[] heap;
+		cap = inlineElems;
+		sz = 0;
+		reallocate(n);
 	}
-	for (unsigned long i = 0; n; ++i) {
-		long m(n >> bitsElem);
-		v[i] = static_cast<elem_t>(n - (m << bitsElem));
-		n = m;
+	std::copy(first, last, data());
+	sz = n;
+}
+
+void bignum::elemVector::swap(elemVector& other) {
+	// the inline elements overlay the heap pointer, so swapping them swaps whichever
+	// of the two is in use
+	std::swap_ranges(local, local + inlineElems, other.local);
+	std::swap(sz, other.sz);
+	std::swap(cap, other.cap);
+}
+
+/* shrinkToFit():
+ * frees the heap memory that is not used by the vector
+ */
+void bignum::elemVector::shrinkToFit() {
+	if (cap > inlineElems && sz < cap) {
+		if (sz <= inlineElems) {
+			elem_t* old(heap);
+			std::copy(old, old + sz, local);
+			delete[] old;
+			cap = inlineElems;
+		}
+		else
+			reallocate(sz);
+	}
+}
+
+/* reallocate(unsigned long n):
+ * restrictions: n >= sz and n > inlineElems
+ * moves the elements to a newly allocated heap block with room for n elements
+ */
+void bignum::elemVector::reallocate(unsigned long n) {
+	elem_t* block(new elem_t[n]);
+	std::copy(data(), data() + sz, block);
+	if (cap > inlineElems)
+		delete[] heap;
+	heap = block;
+	cap = n;
+}
+
+bignum::bignum() : v(), sgn(false) {}
+
+bignum::bignum(long n) : v(), sgn(n < 0) {
+	// the magnitude is computed in unsigned arithmetic so that LONG_MIN is handled
+	unsigned long m(sgn? 0UL - static_cast<unsigned long>(n) :
+					static_cast<unsigned long>(n));
+	v.reserve((sizeof(long) + sizeof(elem_t) - 1) / sizeof(elem_t));
+	while (m) {
+		v.push_back(static_cast<elem_t>(m));
+		// shifting in two steps avoids shifting by the full width of unsigned long
+		m = (m >> (bitsElem - 1)) >> 1;
 	}
-	adjust();
 }
 
 bignum::bignum(const bignum& other) : v(other.v), sgn(other.sgn) {}
 
+bignum::bignum(bignum&& other) noexcept : v(std::move(other.v)), sgn(other.sgn) {
+	other.sgn = false;
+}
+
 bignum& bignum::operator=(const bignum& other) {
 	v = other.v;
 	sgn = other.sgn;
 	return *this;
 }
 
+bignum& bignum::operator=(bignum&& other) noexcept {
+	if (this != &other) {
+		v = std::move(other.v);
+		sgn = other.sgn;
+		other.sgn = false;
+	}
+	return *this;
+}
+
 bignum bignum::operator+(const bignum& other) const {
-	bignum ret(sgn == other.sgn?
-			   unsignedAdd(other) :
-			   unsignedSubtract(other));
-	if (sgn)
-		ret.invert();
+	bignum ret;
+	// room for the carry, so that the sum does not reallocate
+	ret.v.reserve(std::max(v.size(), other.v.size()) + 1);
+	ret.v = v;
+	ret.sgn = sgn;
+	ret += other;
 	return ret;
 }
 
 bignum bignum::operator-(const bignum& other) const {
-	bignum ret(sgn != other.sgn?
-			   unsignedAdd(other) :
-			   unsignedSubtract(other));
-	if (sgn)
-		ret.invert();
+	bignum ret;
+	ret.v.reserve(std::max(v.size(), other.v.size()) + 1);
+	ret.v = v;
+	ret.sgn = sgn;
+	ret -= other;
 	return ret;
 }
 
 bignum bignum::operator*(const bignum& other) const {
 	bignum ret;
+	if (zero() || other.zero())
+		return ret;
 
 	ret.v.resize(v.size() + other.v.size());
-	for (unsigned long shift = 0; shift < other.v.size(); ++shift) {
-		const wide_t otherWide(static_cast<wide_t>(other.v[shift]));
-		wide_t carry = 0;
-		for (unsigned long i = 0; i < v.size(); ++i) {
-			wide_t result(static_cast<wide_t>(v[i]) * otherWide
-						  + static_cast<wide_t>(ret.v[shift+i]) + carry);
-			carry = result >> bitsElem;
-			ret.v[shift + i] = static_cast<elem_t>(result - (carry << bitsElem));
-		}
-		ret.v[shift + v.size()] = static_cast<elem_t>(carry);
-	}
+	// squares are recognized by identity only (x * x), so the other products do not
+	// pay for a comparison of the elements
+	if (&other == this)
+		squareElems(&ret.v[0], &v[0], v.size());
+	else if (v.size() >= other.v.size())
+		multiplyElems(&ret.v[0], &v[0], v.size(), &other.v[0], other.v.size());
+	else
+		multiplyElems(&ret.v[0], &other.v[0], other.v.size(), &v[0], v.size());
 	ret.sgn = sgn xor other.sgn;
 	ret.adjust();
 	ret.shrink();
@@ -105,14 +338,27 @@ bignum bignum::operator>>(long d) const {
 }
 
 bignum& bignum::operator+=(const bignum& other) {
-	return *this = operator+(other);
+	if (sgn == other.sgn)
+		addMagnitude(other);
+	else
+		subtractMagnitude(other);
+	return *this;
 }
 		
 bignum& bignum::operator-=(const bignum& other) {
-	return *this = operator-(other);
+	if (sgn != other.sgn)
+		addMagnitude(other);
+	else
+		subtractMagnitude(other);
+	return *this;
 }
 		
 bignum& bignum::operator*=(const bignum& other) {
+	if (&other != this && other.v.size() == 1) {
+		multiplyByElem(other.v[0]);
+		sgn = !zero() && (sgn xor other.sgn);
+		return *this;
+	}
 	return *this = operator*(other);
 }
 		
@@ -124,6 +370,25 @@ bignum& bignum::operator%=(const bignum& other) {
 	return *this = operator%(other);
 }
 
+/* addmul(const bignum& a, const bignum& b):
+ * makes *this = *this + a * b
+ * returns: *this (after the operation)
+ * note: when one of the factors fits in one element, the product is accumulated in
+ *       place, without temporaries
+ */
+bignum& bignum::addmul(const bignum& a, const bignum& b) {
+	return fusedMultiplyAdd(a, b, false);
+}
+
+/* submul(const bignum& a, const bignum& b):
+ * makes *this = *this - a * b
+ * returns: *this (after the operation)
+ * note: same as addmul
+ */
+bignum& bignum::submul(const bignum& a, const bignum& b) {
+	return fusedMultiplyAdd(a, b, true);
+}
+
 bignum& bignum::operator<<=(long d) {
 	if (d < 0)
 		return operator>>=(-d);
@@ -166,12 +431,12 @@ bignum& bignum::operator>>=(long d) {
 			v.resize(limit);
 		}
 		if (d %= bitsElem) {
-			wide_t revCarry = 0;
+			elem_t revCarry = 0;
 			for (unsigned long i = v.size(); i > 0; ) {
 				--i;
-				wide_t withCarry(static_cast<wide_t>(v[i]) + revCarry);
-				v[i] = withCarry >> d;
-				revCarry = (withCarry - (v[i] << d)) << bitsElem;
+				wide_t withCarry((static_cast<wide_t>(revCarry) << bitsElem) + v[i]);
+				v[i] = static_cast<elem_t>(withCarry >> d);
+				revCarry = static_cast<elem_t>(withCarry - (static_cast<wide_t>(v[i]) << d));
 			}
 			// revCarry final value holds bits that are discarded
 		}
@@ -191,16 +456,8 @@ bignum bignum::operator-() const {
 }
 
 bool bignum::operator==(const bignum& other) const {
-	adjust();
-	other.adjust();
-	if (sgn != other.sgn)
-		return false;
-	if (v.size() != other.v.size())
-		return false;
-	for (unsigned long i = 0; i < v.size(); ++i)
-		if (v[i] != other.v[i])
-			return false;
-	return true;
+	// every operation leaves its result adjusted, so equal numbers have equal elements
+	return sgn == other.sgn && v == other.v;
 }
 
 bool bignum::operator!=(const bignum& other) const {
@@ -293,10 +550,28 @@ bignum& bignum::removeSignal() {
 	return *this;
 }
 
+/* residue(unsigned long m) const:
+ * restrictions: 0 < m < 2^32
+ * returns: the remainder of the division of *this by m (in the range [0, m))
+ */
+unsigned long bignum::residue(unsigned long m) const {
+	// The elements are consumed in chunks of at most 32 bits, so that the partial
+	// remainder shifted by a chunk fits in an unsigned long long
+	const unsigned long chunk(bitsElem < 32? bitsElem : 32);
+	const unsigned long long mask((1ULL << chunk) - 1);
+	unsigned long long r = 0;
+	for (unsigned long i = v.size(); i--; )
+		for (unsigned long s = bitsElem; s; ) {
+			s -= chunk;
+			r = ((r << chunk) | ((static_cast<unsigned long long>(v[i]) >> s) & mask)) % m;
+		}
+	return static_cast<unsigned long>(sgn && r? m - r : r);
+}
+
 // Auxiliary variable to count number of characters read
-static unsigned long charread;
+static thread_local unsigned long charread;
 // Auxiliary variable to store signal read
-static bool sgnread;
+static thread_local bool sgnread;
 /* readFromStream(std::istream& in, base b):
  * reads a representation of number in base b from in and makes *this be that number
  * returns: in (after the operation)
@@ -305,26 +580,20 @@ static bool sgnread;
 std::istream& bignum::readFromStream(std::istream& in, base b) {
 	charread = 0;
 	sgnread = false;
-	const bignum* basebn = 0;
 
 	int (*testfun)(int) = 0;
 	switch (b) {
 	case octal:
-		basebn = &bn8;
 		testfun = isoctal;
 		break;
 	case decimal:
-		basebn = &bn10;
 		testfun = isdigit;
 		break;
 	case hexadecimal:
-		basebn = &bn16;
 		testfun = isxdigit;
 		break;
 	}
 
-#define basebn (*basebn)
-
 #define readskipws()							\
 	do {										\
 		c = in.get();							\
@@ -354,24 +623,27 @@ std::istream& bignum::readFromStream(std::istream& in, base b) {
 		in.clear(std::istream::failbit);
 		return in;
 	}
+	// the digits are converted all at once (see fromDigits)
+	digitBuffer digits;
 	do {
-		*this *= basebn;
-		*this += bignum(c - ('0' <= c && c <= '9'? '0' :
-							 ('a' <= c && c <= 'f'? 'a' : 'A') - 10));
+		digits.push_back(c);
 		c = in.get();
 		++charread;
 		if (c == EOF) {
 			in.clear(std::istream::goodbit);
 			break;
 		}
-		teststream();
+		if (!in.good()) {
+			*this = fromDigits(digits.data(), digits.size(), b);
+			return in;
+		}
 	} while ((*testfun)(c));
 	in.unget();
     --charread;
+	*this = fromDigits(digits.data(), digits.size(), b);
 	if (!zero())
 		sgn = s;
 	return in;
-#undef basebn
 #undef readskipws
 #undef teststream
 }
@@ -384,26 +656,20 @@ std::istream& bignum::readFromStream(std::istream& in, base b) {
 int bignum::readFromFILE(FILE *f, base b) {
 	charread = 0;
 	sgnread = false;
-	const bignum* basebn = 0;
 
 	int (*testfun)(int) = 0;
 	switch (b) {
 	case octal:
-		basebn = &bn8;
 		testfun = isoctal;
 		break;
 	case decimal:
-		basebn = &bn10;
 		testfun = isdigit;
 		break;
 	case hexadecimal:
-		basebn = &bn16;
 		testfun = isxdigit;
 		break;
 	}
 
-#define basebn (*basebn)
-
 #define readskipws()							\
 	do {										\
 		c = fgetc(f);							\
@@ -432,24 +698,25 @@ int bignum::readFromFILE(FILE *f, base b) {
 	if (!(*testfun)(c)) {
 		return 0;
 	}
+	// the digits are converted all at once (see fromDigits)
+	digitBuffer digits;
 	do {
-		*this *= basebn;
-		*this += bignum(c - ('0' <= c && c <= '9'? '0' :
-							 ('a' <= c && c <= 'f'? 'a' : 'A') - 10));
+		digits.push_back(c);
 		c = fgetc(f);
 		++charread;
 		if (c == EOF) {
 			if (feof(f))
 				break; // This means that an EOF was read
+			*this = fromDigits(digits.data(), digits.size(), b);
 			return EOF; // This means that an error occurred
 		}
 	} while ((*testfun)(c));
 	ungetc(c, f);
     --charread;
+	*this = fromDigits(digits.data(), digits.size(), b);
 	if (!zero())
 		sgn = s;
 	return 1;
-#undef basebn
 #undef readskipws
 #undef teststream
 }
@@ -462,23 +729,11 @@ std::ostream& bignum::putOnStreamOct(std::ostream& out) const {
     if (zero())
 		return out << '0';
 
-	if (negative())
-		out << '-';
-
     std::string str;
-    divRes dr(*this, bn0);
-    dr.first.removeSignal();
-    while (!dr.first.zero()) {
-        dr = divide(dr.first, bn8);
-		if (dr.second.zero())
-			str.push_back('0');
-		else
-			str.push_back(dr.second.v.front() + '0');
-    }
-
-    for (unsigned long i = str.size(); i > 0; --i)
-        out << str[i-1];
-    return out;
+	if (negative())
+		str.push_back('-');
+	appendDigits(str, 0, octal);
+    return out << str;
 }
 
 /* putOnStreamDec(std::ostream& out) const:
@@ -489,23 +744,11 @@ std::ostream& bignum::putOnStreamDec(std::ostream& out) const {
     if (zero())
 		return out << '0';
 
-	if (negative())
-		out << '-';
-
     std::string str;
-    divRes dr(*this, bn0);
-    dr.first.removeSignal();
-    while (!dr.first.zero()) {
-        dr = divide(dr.first, bn10);
-		if (dr.second.zero())
-			str.push_back('0');
-		else
-			str.push_back(dr.second.v.front() + '0');
-    }
-
-    for (unsigned long i = str.size(); i > 0; --i)
-        out << str[i-1];
-    return out;
+	if (negative())
+		str.push_back('-');
+	appendDigits(str, 0, decimal);
+    return out << str;
 }
 
 /* putOnStreamHex(std::ostream& out) const:
@@ -517,23 +760,20 @@ std::ostream& bignum::putOnStreamHex(std::ostream& out) const {
 		return out << '0';
     if (sgn)
 		out << '-';
-	std::ostream::fmtflags oldFlags(out.flags());
-	std::streamsize oldWidth(out.width(0));
-	char oldFill(out.fill('0'));
-	
-	out.flags(std::ostream::hex | std::ostream::right);
-	
-	unsigned long i = v.size();
-	if (i > 0) {
-		out << static_cast<wide_t>(v[--i]);
-		out.width(2);
+	static const char digits[] = "0123456789abcdef";
+	const unsigned long digitsElem(bitsElem / 4);
+
+	// every element but the most significant one is printed with all its digits
+	std::string str(v.size() * digitsElem, '0');
+	for (unsigned long i = 0; i < v.size(); ++i) {
+		elem_t e(v[i]);
+		for (unsigned long j = 0; j < digitsElem; ++j) {
+			str[str.size() - i*digitsElem - j - 1] = digits[e & 0xf];
+			e >>= 4;
+		}
 	}
-	while (i > 0)
-		out << static_cast<wide_t>(v[--i]);
-	out.flags(oldFlags);
-	out.width(oldWidth);
-	out.fill(oldFill);
-    return out;
+	const std::string::size_type first(str.find_first_not_of('0'));
+	return out << str.substr(first);
 }
 
 /* putOnStream(std::ostream& out, base b) const:
@@ -593,7 +833,7 @@ void bignum::swap(bignum& other) {
 	std::swap(sgn, other.sgn);
 }
 
-void bignum::adjust() const {
+void bignum::adjust() {
 	if (v.size()) {
 		unsigned long i = v.size();
 		while (i > 0 && !v[--i]) {
@@ -606,153 +846,856 @@ void bignum::adjust() const {
 	}
 }
 		
-/* shrink() const:
+/* shrink():
  * this function attempts to free any unused memory allocated by *this
  */
-void bignum::shrink() const {
-	std::vector<elem_t> w(v.size()); // w is as fit as it can be
-	for (unsigned long i = 0; i < w.size(); ++i)
-		w[i] = v[i];
-	w.swap(v);
+void bignum::shrink() {
+	v.shrinkToFit();
 }
 
-bignum bignum::unsignedAdd(const bignum& other, bool check) const {
-	if (check && v.size() < other.v.size())
-		return other.unsignedAdd(*this, false);
-
-	bignum ret;
-	ret.v.resize(v.size()+1);
-	bool carry = 0;
-	unsigned long i = 0;
-	while (i < other.v.size()) {
-		wide_t result(static_cast<wide_t>(v[i])
-					  + static_cast<wide_t>(other.v[i])
-					  + carry);
-		carry = result >> bitsElem;
-		ret.v[i++] = result - (static_cast<wide_t>(carry) << bitsElem);
-	}
-	while (i < v.size()) {
-		wide_t result(static_cast<wide_t>(v[i]) + carry);
-		carry = result >> bitsElem;
-		ret.v[i++] = result - (static_cast<wide_t>(carry) << bitsElem);
-	}
-	if (carry)
-		ret.v.back() = 1;
-	ret.adjust();
+/* bitLength() const:
+ * returns: the number of bits of the absolute value of *this (0 for zero)
+ * note: assumes *this is adjusted
+ */
+unsigned long bignum::bitLength() const {
+	if (v.empty())
+		return 0;
+	unsigned long ret((v.size() - 1) * bitsElem);
+	for (elem_t e(v.back()); e; e >>= 1)
+		++ret;
 	return ret;
 }
 
-bignum bignum::unsignedSubtract(const bignum& other, bool check) const {
-	if (check) {
-		bool oldSgn(sgn), oldOtherSgn(other.sgn);
-		sgn = false;
-		other.sgn = false;
-		check = operator<(other);
-		sgn = oldSgn;
-		other.sgn = oldOtherSgn;
-		if (check)
-			return other.unsignedSubtract(*this, false).invert();
+/* divideByElem(elem_t d):
+ * restrictions: d > 0
+ * divides the absolute value of *this by d (the signal is kept)
+ * returns: the remainder of the division of the absolute value of *this by d
+ */
+bignum::elem_t bignum::divideByElem(elem_t d) {
+	wide_t rem = 0;
+	for (unsigned long i = v.size(); i > 0; ) {
+		--i;
+		const wide_t cur((rem << bitsElem) + v[i]);
+		v[i] = static_cast<elem_t>(cur / d);
+		rem = cur % d;
 	}
+	adjust();
+	return static_cast<elem_t>(rem);
+}
 
-	bignum ret;
-	ret.v.resize(v.size());
-	const wide_t pull(static_cast<wide_t>(maxElem) + 1);
-	bool revCarry = false;
-	unsigned long i = 0;
-	while (i < other.v.size()) {
-		wide_t result(pull
-					  + static_cast<wide_t>(v[i])
-					  - static_cast<wide_t>(other.v[i])
-					  - revCarry);
-		revCarry = !(result >> bitsElem);
-		ret.v[i++] = result - (static_cast<wide_t>(revCarry) << bitsElem);
-	}
-	while (i < v.size()) {
-		wide_t result(pull
-					  + static_cast<wide_t>(v[i])
-					  - revCarry);
-		revCarry = !(result >> bitsElem);
-		ret.v[i++] = result - (static_cast<wide_t>(revCarry) << bitsElem);
+/* shiftedBits(unsigned long shift) const:
+ * returns: the least significant bits of the absolute value of *this >> shift that fit in
+ *          an unsigned long
+ */
+unsigned long bignum::shiftedBits(unsigned long shift) const {
+	const unsigned long bitsLong(sizeof(unsigned long) * CHAR_BIT);
+	unsigned long ret = 0;
+	for (unsigned long pos = 0; pos < bitsLong; ) {
+		const unsigned long i((shift + pos) / bitsElem), offset((shift + pos) % bitsElem);
+		if (i >= v.size())
+			break;
+		ret |= static_cast<unsigned long>(v[i] >> offset) << pos;
+		pos += bitsElem - offset;
 	}
-	ret.adjust();
 	return ret;
 }
 
-frac::frac(long n, long d) : num(d < 0? -n : n), den(d < 0? -d : d) {
-	if (!d)
-		throw divisionBy0();
-	reduce();
-}
-
-frac::frac(const bignum& n, const bignum& d)
-	: num(d.negative()? -n : n), den(d) {
-	if (d.zero())
-		throw divisionBy0();
-	den.removeSignal();
-	reduce();
+/* toLong(long& l) const:
+ * makes l = *this, if *this fits in a long and is not LONG_MIN
+ * returns: true, iff l was set
+ * note: the values accepted are exactly the ones whose absolute value is also a long
+ */
+bool bignum::toLong(long& l) const {
+	if (v.size() * bitsElem > sizeof(unsigned long) * CHAR_BIT)
+		return false;
+	const unsigned long m(shiftedBits(0));
+	if (m > static_cast<unsigned long>(LONG_MAX))
+		return false;
+	l = sgn? -static_cast<long>(m) : static_cast<long>(m);
+	return true;
 }
 
-frac::frac(const frac& other) : num(other.num), den(other.den) {}
-
-frac& frac::operator=(const frac& other) {
-	num = other.num;
-	den = other.den;
-	return *this;
+/* compareMagnitude(const bignum& other) const:
+ * returns: -1, 0 or 1 if the absolute value of *this is respectively less than, equal
+ *          to or greater than the absolute value of other
+ * note: assumes both numbers are adjusted
+ */
+int bignum::compareMagnitude(const bignum& other) const {
+	return compareElems(&v[0], v.size(), &other.v[0], other.v.size());
 }
 
-frac frac::operator+(const frac& other) const {
-	return frac(num * other.den + other.num * den, den * other.den);
+/* addMagnitude(const bignum& other):
+ * adds the absolute value of other to the absolute value of *this (the signal is kept)
+ */
+void bignum::addMagnitude(const bignum& other) {
+	if (v.size() < other.v.size())
+		v.resize(other.v.size());
+	const elem_t carry(addToElems(&v[0], v.size(), &other.v[0], other.v.size()));
+	if (carry)
+		v.push_back(carry);
 }
 
-frac frac::operator-(const frac& other) const {
-	return frac(num * other.den - other.num * den, den * other.den);
+/* subtractMagnitude(const bignum& other):
+ * subtracts the absolute value of other from the absolute value of *this, flipping
+ * the signal of *this if the absolute value of other is the greatest
+ */
+void bignum::subtractMagnitude(const bignum& other) {
+	if (compareMagnitude(other) >= 0)
+		subtractFromElems(&v[0], v.size(), &other.v[0], other.v.size());
+	else {
+		v.resize(other.v.size());
+		reverseSubtractElems(&v[0], &other.v[0], other.v.size());
+		sgn = !sgn;
+	}
+	adjust();
 }
 
-frac frac::operator*(const frac& other) const {
-	frac f1(num, other.den), f2(other.num, den);
-	return frac(f1.num * f2.num, f1.den * f2.den);
+/* multiplyByElem(elem_t m):
+ * restrictions: m > 0
+ * multiplies the absolute value of *this by m (the signal is kept)
+ */
+void bignum::multiplyByElem(elem_t m) {
+	wide_t carry = 0;
+	for (unsigned long i = 0; i < v.size(); ++i) {
+		wide_t result(static_cast<wide_t>(v[i]) * m + carry);
+		v[i] = static_cast<elem_t>(result);
+		carry = result >> bitsElem;
+	}
+	if (carry)
+		v.push_back(static_cast<elem_t>(carry));
 }
 
-frac frac::operator/(const frac& other) const {
-	frac f1(num, other.num), f2(other.den, den);
-	return frac(f1.num * f2.num, f1.den * f2.den);
-}
+/* fusedMultiplyAdd(const bignum& a, const bignum& b, bool subtract):
+ * makes *this = *this + a * b (or *this - a * b, if subtract is true)
+ * returns: *this (after the operation)
+ * note: when one of the factors fits in one element, neither factor is *this and the
+ *       product does not cancel *this, the product is accumulated in place; otherwise
+ *       it is computed in a scratch buffer of the thread (kept between calls) and
+ *       added to or subtracted from the elements of *this
+ */
+bignum& bignum::fusedMultiplyAdd(const bignum& a, const bignum& b, bool subtract) {
+	if (a.zero() || b.zero())
+		return *this;
+	const bignum *single(b.v.size() == 1? &b : a.v.size() == 1? &a : 0);
+	const bignum& other(single == &b? a : b);
+	const bool productSgn((a.sgn xor b.sgn) xor subtract);
+	if (single && single != this && &other != this && (zero() || sgn == productSgn)) {
+		sgn = productSgn;
+		if (v.size() < other.v.size())
+			v.resize(other.v.size());
+		const elem_t carry(addMultipleToElems(&v[0], v.size(),
+											  &other.v[0], other.v.size(),
+											  single->v[0]));
+		if (carry)
+			v.push_back(carry);
+		return *this;
+	}
 
-frac& frac::operator+=(const frac& other) {
-	return *this = operator+(other);
+	// the multiplication routines never call fusedMultiplyAdd, so the buffer is not
+	// reused while the product is computed
+	static thread_local std::vector<elem_t> scratch;
+	unsigned long n(a.v.size() + b.v.size());
+	if (scratch.size() < n)
+		scratch.resize(n);
+	if (&a == &b)
+		squareElems(&scratch[0], &a.v[0], a.v.size());
+	else if (a.v.size() >= b.v.size())
+		multiplyElems(&scratch[0], &a.v[0], a.v.size(), &b.v[0], b.v.size());
+	else
+		multiplyElems(&scratch[0], &b.v[0], b.v.size(), &a.v[0], a.v.size());
+	if (!scratch[n-1])
+		--n;
+
+	if (zero() || sgn == productSgn) {
+		sgn = productSgn;
+		if (v.size() < n)
+			v.resize(n);
+		const elem_t carry(addToElems(&v[0], v.size(), &scratch[0], n));
+		if (carry)
+			v.push_back(carry);
+	}
+	else if (compareElems(&v[0], v.size(), &scratch[0], n) >= 0) {
+		subtractFromElems(&v[0], v.size(), &scratch[0], n);
+		adjust();
+	}
+	else {
+		v.resize(n);
+		reverseSubtractElems(&v[0], &scratch[0], n);
+		sgn = productSgn;
+		adjust();
+	}
+	return *this;
 }
 
-frac& frac::operator-=(const frac& other) {
-	return *this = operator-(other);
+/* fromUnsignedLong(unsigned long n):
+ * returns: the bignum equal to n
+ */
+bignum bignum::fromUnsignedLong(unsigned long n) {
+	bignum ret;
+	for ( ; n; n = (n >> (bitsElem - 1)) >> 1)
+		ret.v.push_back(static_cast<elem_t>(n));
+	return ret;
 }
 
-frac& frac::operator*=(const frac& other) {
-	return *this = operator*(other);
+/* fromElems(const elem_t *a, unsigned long na):
+ * returns: the non-negative bignum whose elements are a[0], ..., a[na-1]
+ */
+bignum bignum::fromElems(const elem_t *a, unsigned long na) {
+	bignum ret;
+	ret.v.assign(a, a + na);
+	ret.adjust();
+	return ret;
 }
 
-frac& frac::operator/=(const frac& other) {
-	return *this = operator/(other);
-}
+/* fromDigits(const char *digits, unsigned long n, base b):
+ * restrictions: digits[0..n-1] are valid digits in base b
+ * returns: the non-negative bignum represented by digits[0..n-1] in base b
+ * note: numbers with at most fromDigitsThreshold elements are built chunk by chunk
+ *       (each chunk being as many digits as fit in one element); longer ones are split
+ *       in a high and a low part and combined with a cached power of the base, so the
+ *       conversion is as fast as the multiplication
+ */
+bignum bignum::fromDigits(const char *digits, unsigned long n, base b) {
+	const unsigned long k(digitsPerElem(b));
+	if (n > k * fromDigitsThreshold) {
+		unsigned long j = 0;
+		while (k << (j + 1) < n)
+			++j;
+		const unsigned long m(k << j);
+		bignum ret(fromDigits(digits, n - m, b) * chunkPower(b, j));
+		ret.addMagnitude(fromDigits(digits + n - m, m, b));
+		return ret;
+	}
 
-const frac& frac::operator+() const {
-	return *this;
-}
+	const elem_t r(radix(b));
+	bignum ret;
+	if (n <= k) {
+		elem_t chunk(0);
+		for (unsigned long d = 0; d < n; ++d)
+			chunk = static_cast<elem_t>(chunk * r + digitValue(digits[d]));
+		if (chunk)
+			ret.v.push_back(chunk);
+		return ret;
+	}
 
-frac frac::operator-() const {
-	frac ret(*this);
-	return ret.invertSum();
+	elem_t chunkBase(1);
+	for (unsigned long i = 0; i < k; ++i)
+		chunkBase *= r;
+	ret.v.reserve(n / k + 1);
+	for (unsigned long i = 0, len = (n % k? n % k : k); i < n; i += len, len = k) {
+		elem_t chunk(0);
+		for (unsigned long d = i; d < i + len; ++d)
+			chunk = static_cast<elem_t>(chunk * r + digitValue(digits[d]));
+		ret.multiplyByElem(chunkBase);
+		if (ret.v.empty()) {
+			if (chunk)
+				ret.v.push_back(chunk);
+		}
+		else if (addToElems(&ret.v[0], ret.v.size(), &chunk, 1))
+			ret.v.push_back(1);
+	}
+	return ret;
 }
 
-bool frac::operator==(const frac& other) const {
-	return num == other.num && den == other.den;
+/* digitsPerElem(base b):
+ * returns: the number of digits in base b that always fit in one element
+ */
+unsigned long bignum::digitsPerElem(base b) {
+	switch (b) {
+	case octal:
+		return (bitsElem - 1) / 3;
+	case decimal:
+		// floor(bitsElem * log10(2)), exact for the supported element sizes
+		return bitsElem * 30103 / 100000;
+	case hexadecimal:
+		return (bitsElem - 1) / 4;
+	}
+	return 0; //doesn't happen
 }
 
-bool frac::operator!=(const frac& other) const {
-	return !operator==(other);
-}
+/* chunkPower(base b, unsigned long j):
+ * restrictions: j < 64 (the power has 2^j elements or more)
+ * returns: b to the power digitsPerElem(b) * 2^j
+ * note: the powers are computed by repeated squaring and kept for later calls; the
+ *       table only grows, so the powers already computed are read without locking
+ *       and memoMutex is only taken to compute new ones
+ */
+const bignum& bignum::chunkPower(base b, unsigned long j) {
+	static bignum mem[3][64];
+	static std::atomic<unsigned long> computed[3];
+	if (j < computed[b].load(std::memory_order_acquire))
+		return mem[b][j];
+
+	std::lock_guard<std::recursive_mutex> lock(memoMutex);
+	unsigned long n(computed[b].load(std::memory_order_relaxed));
+	if (!n)
+		mem[b][n++] = pow(bignum(static_cast<long>(radix(b))), digitsPerElem(b));
+	for ( ; n <= j; ++n)
+		mem[b][n] = mem[b][n-1] * mem[b][n-1];
+	computed[b].store(n, std::memory_order_release);
+	return mem[b][j];
+}
+
+/* appendDigits(std::string& str, unsigned long width, base b) const:
+ * appends to str the digits of the absolute value of *this in base b, with zeros on the
+ * left up to width digits
+ * note: numbers with at most toDigitsThreshold elements are converted chunk by chunk;
+ *       longer ones are divided by a cached power of the base with about half their
+ *       size and both halves are converted recursively
+ */
+void bignum::appendDigits(std::string& str, unsigned long width, base b) const {
+	static const char digitChars[] = "0123456789abcdef";
+	const unsigned long k(digitsPerElem(b));
+	if (v.size() > toDigitsThreshold) {
+		unsigned long j = 0;
+		while (chunkPower(b, j + 1).v.size() * 2 <= v.size())
+			++j;
+		const unsigned long m(k << j);
+		bignum abs(*this);
+		abs.sgn = false;
+		divRes dr(divide(abs, chunkPower(b, j)));
+		dr.first.appendDigits(str, width > m? width - m : 0, b);
+		dr.second.appendDigits(str, m, b);
+		return;
+	}
 
-bool frac::operator<(const frac& other) const {
-	return num * other.den < other.num * den;
+	const elem_t r(radix(b));
+	elem_t chunkBase(1);
+	for (unsigned long i = 0; i < k; ++i)
+		chunkBase *= r;
+	// the digits are generated from the least significant one
+	std::string rev;
+	rev.reserve(v.size() * k);
+	bignum q(*this);
+	while (!q.zero()) {
+		elem_t chunk(q.divideByElem(chunkBase));
+		for (unsigned long i = 0; i < k; ++i) {
+			rev.push_back(digitChars[chunk % r]);
+			chunk /= r;
+		}
+	}
+	while (!rev.empty() && rev[rev.size() - 1] == '0')
+		rev.erase(rev.size() - 1);
+	if (width > rev.size())
+		str.append(width - rev.size(), '0');
+	str.append(rev.rbegin(), rev.rend());
+}
+
+/* addElems(elem_t *r, const elem_t *a, unsigned long na,
+ *          const elem_t *b, unsigned long nb):
+ * restrictions: na >= nb and r has room for na elements
+ * makes r[0..na-1] be the na least significant elements of a + b
+ * returns: the carry out of the most significant element
+ */
+bignum::elem_t bignum::addElems(elem_t *r, const elem_t *a, unsigned long na,
+								const elem_t *b, unsigned long nb) {
+	wide_t carry = 0;
+	unsigned long i = 0;
+	for ( ; i < nb; ++i) {
+		wide_t result(static_cast<wide_t>(a[i]) + b[i] + carry);
+		r[i] = static_cast<elem_t>(result);
+		carry = result >> bitsElem;
+	}
+	for ( ; i < na; ++i) {
+		wide_t result(static_cast<wide_t>(a[i]) + carry);
+		r[i] = static_cast<elem_t>(result);
+		carry = result >> bitsElem;
+	}
+	return static_cast<elem_t>(carry);
+}
+
+/* addToElems(elem_t *r, unsigned long nr, const elem_t *a, unsigned long na):
+ * restrictions: nr >= na
+ * adds a[0..na-1] to r[0..nr-1]
+ * returns: the carry out of r[nr-1]
+ */
+bignum::elem_t bignum::addToElems(elem_t *r, unsigned long nr,
+								  const elem_t *a, unsigned long na) {
+	wide_t carry = 0;
+	unsigned long i = 0;
+	for ( ; i < na; ++i) {
+		wide_t result(static_cast<wide_t>(r[i]) + a[i] + carry);
+		r[i] = static_cast<elem_t>(result);
+		carry = result >> bitsElem;
+	}
+	for ( ; carry && i < nr; ++i) {
+		wide_t result(static_cast<wide_t>(r[i]) + carry);
+		r[i] = static_cast<elem_t>(result);
+		carry = result >> bitsElem;
+	}
+	return static_cast<elem_t>(carry);
+}
+
+/* compareElems(const elem_t *a, unsigned long na, const elem_t *b, unsigned long nb):
+ * restrictions: a[na-1] and b[nb-1] are non-zero (if they exist)
+ * returns: a negative number, zero or a positive number if a[0..na-1] is respectively
+ *          less than, equal to or greater than b[0..nb-1]
+ */
+int bignum::compareElems(const elem_t *a, unsigned long na,
+						 const elem_t *b, unsigned long nb) {
+	if (na != nb)
+		return na < nb? -1 : 1;
+	for (unsigned long i = na; i > 0; ) {
+		--i;
+		if (a[i] != b[i])
+			return a[i] < b[i]? -1 : 1;
+	}
+	return 0;
+}
+
+/* subtractFromElems(elem_t *r, unsigned long nr, const elem_t *a, unsigned long na):
+ * restrictions: nr >= na
+ * subtracts a[0..na-1] from r[0..nr-1]
+ * returns: the borrow out of r[nr-1]
+ */
+bignum::elem_t bignum::subtractFromElems(elem_t *r, unsigned long nr,
+										 const elem_t *a, unsigned long na) {
+	bool borrow = false;
+	unsigned long i = 0;
+	for ( ; i < na; ++i) {
+		const elem_t ri(r[i]);
+		r[i] = static_cast<elem_t>(ri - a[i] - borrow);
+		borrow = ri < a[i] || (ri == a[i] && borrow);
+	}
+	for ( ; borrow && i < nr; ++i)
+		borrow = !r[i]--;
+	return borrow;
+}
+
+/* reverseSubtractElems(elem_t *r, const elem_t *a, unsigned long n):
+ * restrictions: a[0..n-1] >= r[0..n-1]
+ * makes r[0..n-1] be a[0..n-1] - r[0..n-1]
+ */
+void bignum::reverseSubtractElems(elem_t *r, const elem_t *a, unsigned long n) {
+	bool borrow = false;
+	for (unsigned long i = 0; i < n; ++i) {
+		const elem_t ai(a[i]), ri(r[i]);
+		r[i] = static_cast<elem_t>(ai - ri - borrow);
+		borrow = ai < ri || (ai == ri && borrow);
+	}
+}
+
+/* addMultipleToElems(elem_t *r, unsigned long nr, const elem_t *a, unsigned long na,
+ *                    elem_t m):
+ * restrictions: nr >= na
+ * adds m times a[0..na-1] to r[0..nr-1]
+ * returns: the carry out of r[nr-1]
+ */
+bignum::elem_t bignum::addMultipleToElems(elem_t *r, unsigned long nr,
+										  const elem_t *a, unsigned long na, elem_t m) {
+	wide_t carry = 0;
+	unsigned long i = 0;
+	for ( ; i < na; ++i) {
+		wide_t result(static_cast<wide_t>(a[i]) * m + r[i] + carry);
+		r[i] = static_cast<elem_t>(result);
+		carry = result >> bitsElem;
+	}
+	for ( ; carry && i < nr; ++i) {
+		wide_t result(static_cast<wide_t>(r[i]) + carry);
+		r[i] = static_cast<elem_t>(result);
+		carry = result >> bitsElem;
+	}
+	return static_cast<elem_t>(carry);
+}
+
+/* multiplyElems(elem_t *r, const elem_t *a, unsigned long na,
+ *               const elem_t *b, unsigned long nb):
+ * restrictions: na >= nb > 0, r has room for na + nb elements and does not overlap a or b
+ * makes r[0..na+nb-1] be the product of a[0..na-1] and b[0..nb-1]
+ * note: chooses between the schoolbook, Karatsuba and Toom-3 algorithms according
+ *       to the size of the operands
+ */
+void bignum::multiplyElems(elem_t *r, const elem_t *a, unsigned long na,
+						   const elem_t *b, unsigned long nb) {
+	if (nb < karatsubaThreshold) {
+		multiplySchoolbook(r, a, na, b, nb);
+		return;
+	}
+	if (2 * nb <= na + 1) {
+		// Unbalanced operands: multiply b by slices of a with nb elements each
+		std::fill(r, r + na + nb, elem_t(0));
+		std::vector<elem_t> t(2 * nb);
+		for (unsigned long i = 0; i < na; i += nb) {
+			const unsigned long len(std::min(nb, na - i));
+			multiplyElems(&t[0], b, nb, a + i, len);
+			addToElems(r + i, na + nb - i, &t[0], nb + len);
+		}
+	}
+	else if (nb < toom3Threshold || nb <= 2 * ((na + 2) / 3))
+		multiplyKaratsuba(r, a, na, b, nb);
+	else
+		multiplyToom3(r, a, na, b, nb);
+}
+
+/* multiplySchoolbook(elem_t *r, const elem_t *a, unsigned long na,
+ *                    const elem_t *b, unsigned long nb):
+ * same as multiplyElems, but always uses the quadratic schoolbook algorithm
+ */
+void bignum::multiplySchoolbook(elem_t *r, const elem_t *a, unsigned long na,
+								const elem_t *b, unsigned long nb) {
+	std::fill(r, r + na, elem_t(0));
+	for (unsigned long shift = 0; shift < nb; ++shift) {
+		const wide_t bWide(static_cast<wide_t>(b[shift]));
+		wide_t carry = 0;
+		for (unsigned long i = 0; i < na; ++i) {
+			wide_t result(static_cast<wide_t>(a[i]) * bWide
+						  + static_cast<wide_t>(r[shift + i]) + carry);
+			carry = result >> bitsElem;
+			r[shift + i] = static_cast<elem_t>(result);
+		}
+		r[shift + na] = static_cast<elem_t>(carry);
+	}
+}
+
+/* multiplyKaratsuba(elem_t *r, const elem_t *a, unsigned long na,
+ *                   const elem_t *b, unsigned long nb):
+ * restrictions: na >= nb > (na + 1) / 2
+ * same as multiplyElems, but the topmost step uses Karatsuba's algorithm: with
+ * a = a0 + a1 X and b = b0 + b1 X, a b = a0 b0 + ((a0 + a1)(b0 + b1) - a0 b0 - a1 b1) X
+ * + a1 b1 X^2
+ */
+void bignum::multiplyKaratsuba(elem_t *r, const elem_t *a, unsigned long na,
+							   const elem_t *b, unsigned long nb) {
+	const unsigned long h((na + 1) / 2), na1(na - h), nb1(nb - h);
+
+	// a0 b0 goes to r[0..2h-1] and a1 b1 goes to r[2h..na+nb-1]
+	multiplyElems(r, a, h, b, h);
+	multiplyElems(r + 2*h, a + h, na1, b + h, nb1);
+
+	std::vector<elem_t> sa(h + 1), sb(h + 1), mid(2*h + 2);
+	sa[h] = addElems(&sa[0], a, h, a + h, na1);
+	sb[h] = addElems(&sb[0], b, h, b + h, nb1);
+	const unsigned long nsa(sa[h]? h + 1 : h), nsb(sb[h]? h + 1 : h);
+	if (nsa >= nsb)
+		multiplyElems(&mid[0], &sa[0], nsa, &sb[0], nsb);
+	else
+		multiplyElems(&mid[0], &sb[0], nsb, &sa[0], nsa);
+	subtractFromElems(&mid[0], mid.size(), r, 2*h);
+	subtractFromElems(&mid[0], mid.size(), r + 2*h, na1 + nb1);
+
+	// a0 b1 + a1 b0 < X^2, so the leading elements of mid are zero
+	unsigned long nmid(std::min(mid.size(), na + nb - h));
+	addToElems(r + h, na + nb - h, &mid[0], nmid);
+}
+
+/* multiplyToom3(elem_t *r, const elem_t *a, unsigned long na,
+ *               const elem_t *b, unsigned long nb):
+ * restrictions: na >= nb > 2 ((na + 2) / 3)
+ * same as multiplyElems, but the topmost step uses the Toom-3 algorithm: a and b are
+ * split in three parts each and seen as polynomials of degree 2, their product is
+ * evaluated at 0, 1, -1, -2 and infinity and then recovered by interpolation
+ */
+void bignum::multiplyToom3(elem_t *r, const elem_t *a, unsigned long na,
+						   const elem_t *b, unsigned long nb) {
+	const unsigned long k((na + 2) / 3);
+	bignum a0(fromElems(a, k)), a1(fromElems(a + k, k)), a2(fromElems(a + 2*k, na - 2*k));
+	bignum b0(fromElems(b, k)), b1(fromElems(b + k, k)), b2(fromElems(b + 2*k, nb - 2*k));
+
+	// Evaluation (the sub-products go through operator*, hence through multiplyElems)
+	bignum pa(a0 + a2), pb(b0 + b2);
+	bignum pa1(pa + a1), pb1(pb + b1), pam1(pa - a1), pbm1(pb - b1);
+	bignum pam2(((pam1 + a2) << 1) - a0), pbm2(((pbm1 + b2) << 1) - b0);
+
+	bignum v0(a0 * b0), v1(pa1 * pb1), vm1(pam1 * pbm1), vm2(pam2 * pbm2), vinf(a2 * b2);
+	interpolateToom3(r, na + nb, k, v0, v1, vm1, vm2, vinf);
+}
+
+/* interpolateToom3(elem_t *r, unsigned long nr, unsigned long k,
+ *                  bignum& v0, bignum& v1, bignum& vm1, bignum& vm2, bignum& vinf):
+ * restrictions: v0, v1, vm1, vm2 and vinf are the values at 0, 1, -1, -2 and infinity
+ *               of a polynomial of degree 4 with non-negative coefficients whose
+ *               value at X = 2^(k bitsElem) fits in nr elements
+ * makes r[0..nr-1] be the value of the polynomial at X
+ * note: the arguments are used as scratch space
+ */
+void bignum::interpolateToom3(elem_t *r, unsigned long nr, unsigned long k,
+							  bignum& v0, bignum& v1, bignum& vm1, bignum& vm2,
+							  bignum& vinf) {
+	// Bodrato's interpolation sequence (all divisions are exact)
+	bignum& r3(vm2);
+	r3 -= v1;
+	r3.divideByElem(3);
+	bignum& r1(v1);
+	r1 -= vm1;
+	r1 >>= 1;
+	bignum& r2(vm1);
+	r2 -= v0;
+	r3 = r2 - r3;
+	r3 >>= 1;
+	r3 += vinf << 1;
+	r2 += r1;
+	r2 -= vinf;
+	r1 -= r3;
+
+	std::fill(r, r + nr, elem_t(0));
+	const bignum* coeffs[] = {&v0, &r1, &r2, &r3, &vinf};
+	for (unsigned long i = 0; i < 5; ++i)
+		if (!coeffs[i]->zero())
+			addToElems(r + i*k, nr - i*k, &coeffs[i]->v[0], coeffs[i]->v.size());
+}
+
+/* squareElems(elem_t *r, const elem_t *a, unsigned long na):
+ * restrictions: na > 0, r has room for 2 na elements and does not overlap a
+ * makes r[0..2na-1] be the square of a[0..na-1]
+ * note: chooses between the schoolbook, Karatsuba and Toom-3 algorithms according
+ *       to the size of the operand
+ */
+void bignum::squareElems(elem_t *r, const elem_t *a, unsigned long na) {
+	if (na < karatsubaSqrThreshold)
+		squareSchoolbook(r, a, na);
+	else if (na < toom3SqrThreshold)
+		squareKaratsuba(r, a, na);
+	else
+		squareToom3(r, a, na);
+}
+
+/* squareSchoolbook(elem_t *r, const elem_t *a, unsigned long na):
+ * same as squareElems, but always uses the quadratic schoolbook algorithm (each
+ * product a[i] a[j] with i != j is computed only once)
+ */
+void bignum::squareSchoolbook(elem_t *r, const elem_t *a, unsigned long na) {
+	std::fill(r, r + 2*na, elem_t(0));
+	for (unsigned long i = 0; i + 1 < na; ++i) {
+		const wide_t aWide(static_cast<wide_t>(a[i]));
+		wide_t carry = 0;
+		for (unsigned long j = i + 1; j < na; ++j) {
+			wide_t result(aWide * a[j] + static_cast<wide_t>(r[i + j]) + carry);
+			carry = result >> bitsElem;
+			r[i + j] = static_cast<elem_t>(result);
+		}
+		r[i + na] = static_cast<elem_t>(carry);
+	}
+
+	// doubles the products computed and adds the squares a[i]^2
+	elem_t top = 0;
+	for (unsigned long i = 0; i < 2*na; ++i) {
+		const elem_t next(static_cast<elem_t>(r[i] >> (bitsElem - 1)));
+		r[i] = static_cast<elem_t>((r[i] << 1) | top);
+		top = next;
+	}
+	wide_t carry = 0;
+	for (unsigned long i = 0; i < na; ++i) {
+		const wide_t square(static_cast<wide_t>(a[i]) * a[i]);
+		wide_t result(static_cast<wide_t>(r[2*i])
+					  + static_cast<elem_t>(square) + carry);
+		r[2*i] = static_cast<elem_t>(result);
+		carry = result >> bitsElem;
+		result = static_cast<wide_t>(r[2*i + 1]) + (square >> bitsElem) + carry;
+		r[2*i + 1] = static_cast<elem_t>(result);
+		carry = result >> bitsElem;
+	}
+}
+
+/* squareKaratsuba(elem_t *r, const elem_t *a, unsigned long na):
+ * same as squareElems, but the topmost step uses Karatsuba's algorithm
+ */
+void bignum::squareKaratsuba(elem_t *r, const elem_t *a, unsigned long na) {
+	const unsigned long h((na + 1) / 2), na1(na - h);
+
+	squareElems(r, a, h);
+	squareElems(r + 2*h, a + h, na1);
+
+	std::vector<elem_t> sa(h + 1), mid(2*h + 2);
+	sa[h] = addElems(&sa[0], a, h, a + h, na1);
+	const unsigned long nsa(sa[h]? h + 1 : h);
+	squareElems(&mid[0], &sa[0], nsa);
+	subtractFromElems(&mid[0], mid.size(), r, 2*h);
+	subtractFromElems(&mid[0], mid.size(), r + 2*h, 2*na1);
+
+	unsigned long nmid(std::min(mid.size(), 2*na - h));
+	addToElems(r + h, 2*na - h, &mid[0], nmid);
+}
+
+/* squareToom3(elem_t *r, const elem_t *a, unsigned long na):
+ * same as squareElems, but the topmost step uses the Toom-3 algorithm
+ */
+void bignum::squareToom3(elem_t *r, const elem_t *a, unsigned long na) {
+	const unsigned long k((na + 2) / 3);
+	bignum a0(fromElems(a, k)), a1(fromElems(a + k, k)), a2(fromElems(a + 2*k, na - 2*k));
+
+	bignum pa(a0 + a2);
+	bignum pa1(pa + a1), pam1(pa - a1);
+	bignum pam2(((pam1 + a2) << 1) - a0);
+
+	// operator* recognizes squares, so these go through squareElems
+	bignum v0(a0 * a0), v1(pa1 * pa1), vm1(pam1 * pam1), vm2(pam2 * pam2), vinf(a2 * a2);
+	interpolateToom3(r, 2*na, k, v0, v1, vm1, vm2, vinf);
+}
+
+frac::frac(long n, long d) : num(d < 0? -n : n), den(d < 0? -d : d) {
+	if (!d)
+		throw divisionBy0();
+	reduce();
+}
+
+frac::frac(const bignum& n, const bignum& d)
+	: num(d.negative()? -n : n), den(d) {
+	if (d.zero())
+		throw divisionBy0();
+	den.removeSignal();
+	reduce();
+}
+
+frac::frac(const frac& other) : num(other.num), den(other.den) {}
+
+frac::frac(frac&& other) noexcept : num(std::move(other.num)), den(std::move(other.den)) {
+	// one fits in the inline elements, so this does not allocate
+	other.den = bn1;
+}
+
+frac& frac::operator=(const frac& other) {
+	num = other.num;
+	den = other.den;
+	return *this;
+}
+
+frac& frac::operator=(frac&& other) noexcept {
+	if (this != &other) {
+		num = std::move(other.num);
+		den = std::move(other.den);
+		other.den = bn1;
+	}
+	return *this;
+}
+
+frac frac::operator+(const frac& other) const {
+	frac ret(*this);
+	ret += other;
+	return ret;
+}
+
+frac frac::operator-(const frac& other) const {
+	frac ret(*this);
+	ret -= other;
+	return ret;
+}
+
+frac frac::operator*(const frac& other) const {
+	frac ret(*this);
+	ret *= other;
+	return ret;
+}
+
+frac frac::operator/(const frac& other) const {
+	frac ret(*this);
+	ret /= other;
+	return ret;
+}
+
+frac& frac::operator+=(const frac& other) {
+	long a, b, c, d;
+	if (num.toLong(a) && den.toLong(b) && other.num.toLong(c) && other.den.toLong(d)
+		&& addSmall(a, b, c, d))
+		return *this;
+	if (&other == this)
+		num <<= 1;
+	else if (den == other.den)
+		num += other.num;
+	else {
+		num *= other.den;
+		num.addmul(other.num, den);
+		den *= other.den;
+	}
+	reduce();
+	return *this;
+}
+
+frac& frac::operator-=(const frac& other) {
+	long a, b, c, d;
+	if (num.toLong(a) && den.toLong(b) && other.num.toLong(c) && other.den.toLong(d)
+		&& addSmall(a, b, -c, d))
+		return *this;
+	if (&other == this)
+		num = bn0;
+	else if (den == other.den)
+		num -= other.num;
+	else {
+		num *= other.den;
+		num.submul(other.num, den);
+		den *= other.den;
+	}
+	reduce();
+	return *this;
+}
+
+frac& frac::operator*=(const frac& other) {
+	long a, b, c, d;
+	if (num.toLong(a) && den.toLong(b) && other.num.toLong(c) && other.den.toLong(d)
+		&& multiplySmall(a, b, c, d))
+		return *this;
+	if (zero() || other.zero()) {
+		num = bn0;
+		den = bn1;
+	}
+	else if (&other == this) {
+		// the squares of co-prime numbers are co-prime
+		num *= num;
+		den *= den;
+	}
+	else {
+		// both operands are reduced, so cancelling the crossed factors leaves the
+		// product reduced
+		bignum otherNum(other.num), otherDen(other.den);
+		divideByGcd(num, otherDen);
+		divideByGcd(otherNum, den);
+		num *= otherNum;
+		den *= otherDen;
+	}
+	return *this;
+}
+
+frac& frac::operator/=(const frac& other) {
+	if (other.zero())
+		throw divisionBy0();
+	long a, b, c, d;
+	if (num.toLong(a) && den.toLong(b) && other.num.toLong(c) && other.den.toLong(d)
+		&& (c > 0? multiplySmall(a, b, d, c) : multiplySmall(a, b, -d, -c)))
+		return *this;
+	frac inverse(other);
+	return operator*=(inverse.invertProd());
+}
+
+/* addmul(const frac& a, const frac& b):
+ * makes *this = *this + a * b
+ * returns: *this (after the operation)
+ * note: the product is not built as a frac (see fusedMultiplyAdd)
+ */
+frac& frac::addmul(const frac& a, const frac& b) {
+	return fusedMultiplyAdd(a, b, false);
+}
+
+/* submul(const frac& a, const frac& b):
+ * makes *this = *this - a * b
+ * returns: *this (after the operation)
+ * note: same as addmul
+ */
+frac& frac::submul(const frac& a, const frac& b) {
+	return fusedMultiplyAdd(a, b, true);
+}
+
+const frac& frac::operator+() const {
+	return *this;
+}
+
+frac frac::operator-() const {
+	frac ret(*this);
+	return ret.invertSum();
+}
+
+bool frac::operator==(const frac& other) const {
+	return num == other.num && den == other.den;
+}
+
+bool frac::operator!=(const frac& other) const {
+	return !operator==(other);
+}
+
+bool frac::operator<(const frac& other) const {
+	long a, b, c, d, ad, cb;
+	if (num.toLong(a) && den.toLong(b) && other.num.toLong(c) && other.den.toLong(d)
+		&& checkedMul(a, d, ad) && checkedMul(c, b, cb))
+		return ad < cb;
+	return num * other.den < other.num * den;
 }
 
 bool frac::operator<=(const frac& other) const {
@@ -804,6 +1747,14 @@ frac& frac::removeSignal() {
 	return *this;
 }
 
+const bignum& frac::numerator() const {
+	return num;
+}
+
+const bignum& frac::denominator() const {
+	return den;
+}
+
 /* readFromStream(std::istream& in, base b):
  * reads a number represented as a quotient of floating points or just one floating point
  * in base b from in and makes *this be that number
@@ -850,6 +1801,9 @@ std::istream& frac::readFromStream(std::istream& in, base b) {
  * returns: in (after the operation)
  */
 std::istream& frac::readFromStreamPoint(std::istream& in, base b) {
+	if (b == decimal)
+		return readFromStreamDecimal(in);
+
 	const bignum* basebn = 0;
 	int expchar = 'p';
 
@@ -1011,6 +1965,9 @@ int frac::readFromFILE(FILE *f, base b) {
  * returns: EOF, if an error occurred; 0, if read bad formatted string; 1, otherwise
  */
 int frac::readFromFILEPoint(FILE *f, base b) {
+	if (b == decimal)
+		return readFromFILEDecimal(f);
+
 	const bignum* basebn = 0;
 	int expchar = 'p';
 	int r;
@@ -1118,6 +2075,240 @@ int frac::readFromFILEPoint(FILE *f, base b) {
 #undef testEOFanderror
 }
 
+/* readFromStreamDecimal(std::istream& in):
+ * reads a floating point representation of number in base 10 from in and
+ * makes *this be that number
+ * returns: in (after the operation)
+ * note: this is readFromStreamPoint(in, decimal): all digits (before and after the
+ *       point) are kept together and converted at once by assignDecimal
+ */
+std::istream& frac::readFromStreamDecimal(std::istream& in) {
+#define testEOF(INST)							\
+	if (c == EOF) {								\
+		in.clear(std::istream::goodbit);		\
+		INST;									\
+	}
+
+#define teststream()							\
+	if (!in.good())								\
+		return in
+
+#define readskipws()							\
+	do {										\
+		c = in.get();							\
+	} while (in.good() && isspace(c))
+
+	// the stream may end after the mantissa
+#define testmantissa()													\
+	if (!in.good()) {													\
+		assignDecimal(negative, digits.data(), digits.size(), exponent);	\
+		return in;														\
+	}
+
+	*this = frac();
+
+	digitBuffer digits;
+	bool negative = false;
+	long exponent = 0;
+	int c = in.peek();
+	testEOF(return in);
+	teststream();
+	if (c == '.') {
+		in.ignore();
+		c = in.peek();
+		testEOF(return in);
+		teststream();
+		if (!isdigit(c)) {
+			in.putback('.');
+			in.clear(std::istream::failbit);
+			return in;
+		}
+	}
+	else {
+		readskipws();
+		teststream();
+		switch (c) {
+		case '-':
+			negative = true;
+			// fall through
+		case '+':
+			readskipws();
+			teststream();
+			break;
+		}
+		if (!isdigit(c)) {
+			in.clear(std::istream::failbit);
+			return in;
+		}
+		do {
+			digits.push_back(c);
+			c = in.get();
+		} while (in.good() && isdigit(c));
+		testEOF(assignDecimal(negative, digits.data(), digits.size(), 0); return in);
+		teststream();
+		if (c != '.') {
+			in.unget();
+			c = '\0';
+		}
+		else {
+			c = in.peek();
+			testEOF(assignDecimal(negative, digits.data(), digits.size(), 0); return in);
+			teststream();
+		}
+	}
+	// Here c is the peeked character after the point (or '\0' if there is no point)
+	if (isdigit(c)) {
+		do {
+			in.ignore();
+			digits.push_back(c);
+			--exponent;
+			c = in.peek();
+		} while (in.good() && isdigit(c));
+		testEOF(assignDecimal(negative, digits.data(), digits.size(), exponent);
+				return in);
+		teststream();
+	}
+	else
+		c = in.peek();
+	if (c == 'e' || c == 'E') {
+		in.ignore();
+		c = in.peek();
+		testmantissa();
+		bool expNegative = false;
+		switch (c) {
+		case '-':
+			expNegative = true;
+			// fall through
+		case '+':
+			in.ignore();
+			c = in.peek();
+			testmantissa();
+			break;
+		}
+		if (!isdigit(c)) {
+			in.clear(std::istream::failbit);
+			return in;
+		}
+		long exp = 0;
+		do {
+			in.ignore();
+			teststream();
+			exp *= 10;
+			exp += c - '0';
+			c = in.peek();
+			testEOF(break);
+		} while (isdigit(c));
+		exponent += expNegative? -exp : exp;
+	}
+	assignDecimal(negative, digits.data(), digits.size(), exponent);
+	return in;
+#undef testEOF
+#undef teststream
+#undef readskipws
+#undef testmantissa
+}
+
+/* readFromFILEDecimal(FILE *f):
+ * reads a floating point representation of number in base 10 from f and
+ * makes *this be that number
+ * returns: EOF, if an error occurred; 0, if read bad formatted string; 1, otherwise
+ * note: this is readFromFILEPoint(f, decimal): all digits (before and after the point)
+ *       are kept together and converted at once by assignDecimal
+ */
+int frac::readFromFILEDecimal(FILE *f) {
+#define testEOFanderror(INST)					\
+	if (c == EOF) {								\
+		if (!feof(f))							\
+			return EOF;							\
+		INST;									\
+	}
+
+#define readskipws()							\
+	do {										\
+		c = fgetc(f);							\
+	} while (c != EOF && isspace(c))
+
+	*this = frac();
+
+	digitBuffer digits;
+	bool negative = false;
+	long exponent = 0;
+	int c = fgetc(f);
+	if (c == '.') {
+		c = fgetc(f);
+		testEOFanderror(ungetc('.', f); return 0);
+		if (!isdigit(c)) {
+			ungetc(c, f);
+			return 0;
+		}
+	}
+	else {
+		ungetc(c, f);
+		readskipws();
+		if (c == EOF)
+			return EOF;
+		switch (c) {
+		case '-':
+			negative = true;
+			// fall through
+		case '+':
+			readskipws();
+			if (c == EOF)
+				return EOF;
+			break;
+		}
+		if (!isdigit(c))
+			return 0;
+		do {
+			digits.push_back(c);
+			c = fgetc(f);
+		} while (isdigit(c));
+		testEOFanderror(assignDecimal(negative, digits.data(), digits.size(), 0);
+						return 1);
+		if (c == '.') {
+			c = fgetc(f);
+			testEOFanderror(assignDecimal(negative, digits.data(), digits.size(), 0);
+							return 1);
+		}
+	}
+	while (isdigit(c)) {
+		digits.push_back(c);
+		--exponent;
+		c = fgetc(f);
+	}
+	testEOFanderror(assignDecimal(negative, digits.data(), digits.size(), exponent);
+					return 1);
+	if (c == 'e' || c == 'E') {
+		c = fgetc(f);
+		testEOFanderror(return EOF);
+		bool expNegative = false;
+		switch (c) {
+		case '-':
+			expNegative = true;
+			// fall through
+		case '+':
+			c = fgetc(f);
+			testEOFanderror(return EOF);
+			break;
+		}
+		if (!isdigit(c))
+			return 0;
+		long exp = 0;
+		do {
+			exp *= 10;
+			exp += c - '0';
+			c = fgetc(f);
+			testEOFanderror(break);
+		} while (isdigit(c));
+		exponent += expNegative? -exp : exp;
+	}
+	ungetc(c, f);
+	assignDecimal(negative, digits.data(), digits.size(), exponent);
+	return 1;
+#undef testEOFanderror
+#undef readskipws
+}
+
 /* putOnStreamOct(std::ostream& out) const:
  * puts a string representing *this in base 8 on stream out
  * returns: out (after operation)
@@ -1190,23 +2381,31 @@ std::ostream& frac::putOnStreamPoint(std::ostream& out,
 
 	bignum altden(den);
 	std::stringstream expss;
+	// The exponent is first estimated from the bit lengths (from below, with a margin
+	// for the rounding of log) and then corrected one power at a time
+	const double bitsPerDigit(std::log(static_cast<double>(radix(b))) / std::log(2.0));
+	const unsigned long numBits(altnum.bitLength()), denBits(altden.bitLength());
 	if (altnum >= altden) {
-		unsigned long t = 0;
-		bignum aux;
-		bignum *a = &altden, *b = &aux;
-		do {
-			*b = *a * basebn;
-			bignum *c = b;
-			b = a;
-			a = c;
+		unsigned long t(numBits > denBits + 2?
+						static_cast<unsigned long>((numBits - denBits - 1) / bitsPerDigit)
+						: 0);
+		if (t)
+			altden *= pow(basebn, --t);
+		for (bignum next(altden * basebn); altnum >= next; next *= basebn) {
+			altden = next;
 			++t;
-		} while (altnum >= *a);
-		altden = *b;
-		if (--t)
+		}
+		if (t)
 			expss << expchar << t; // t is in base 10
 	}
 	else {
-		unsigned long t = 0;
+		unsigned long t(denBits > numBits + 2?
+						static_cast<unsigned long>((denBits - numBits - 1) / bitsPerDigit)
+						: 0);
+		if (t > 1)
+			altnum *= pow(basebn, --t);
+		else
+			t = 0;
 		do {
 			altnum *= basebn;
 			++t;
@@ -1296,30 +2495,67 @@ frac frac::rounded(frac prec) const {
 	return frac(fdr.first * prec.num, prec.den);
 }
 
+/* bestApproximation(bignum a, bignum b, const bignum& n, bignum& p, bignum& q):
+ * restrictions: a >= 0, b > 0 and n > 0
+ * makes p / q be the fraction closest to a / b with 0 < q <= n (the one with the
+ * smallest denominator in case of a tie)
+ * note: the closest fraction is either the last convergent of the continued fraction
+ *       of a / b whose denominator is at most n or the largest semiconvergent after
+ *       it, so only O(log(n)) divisions are needed (this is the walk down the
+ *       Stern-Brocot tree, taking the runs of equal turns at once)
+ */
+static void bestApproximation(bignum a, bignum b, const bignum& n, bignum& p, bignum& q) {
+	const bignum x(a), y(b);
+	// (p0 / q0, p / q) are the last two convergents
+	bignum p0, q0(bn1);
+	p = bn1;
+	q = bignum();
+	while (!b.zero()) {
+		divRes dr(divide(a, b));
+		bignum q2(q0);
+		q2.addmul(dr.first, q);
+		if (q2 > n) {
+			// Largest semiconvergent with denominator at most n
+			bignum t(divide(n - q0, q).first);
+			bignum ps(p0), qs(q0);
+			ps.addmul(t, p);
+			qs.addmul(t, q);
+			bignum errC(x * q - p * y), errS(x * qs - ps * y);
+			errC.removeSignal();
+			errS.removeSignal();
+			errC *= qs;
+			errS *= q;
+			if (errS < errC || (errS == errC && qs < q)) {
+				p.swap(ps);
+				q.swap(qs);
+			}
+			return;
+		}
+		bignum p2(p0);
+		p2.addmul(dr.first, p);
+		p0.swap(p);
+		p.swap(p2);
+		q0.swap(q);
+		q.swap(q2);
+		a.swap(b);
+		b.swap(dr.second);
+	}
+}
+
 /* humanRounded(unsigned long n) const:
  * restrictions: n > 0
  * returns: the (integer) multiple of a fraction a / b that is closest to *this
  *          with the restriction that b <= n
- * note: this function is much slower than rounded(const frac&) but produces
- *       results somewhat closer to how a human would round a fraction
+ * note: this is the best rational approximation of *this with denominator at most n,
+ *       found by continued fractions in O(log(n)) divisions; it produces results
+ *       somewhat closer to how a human would round a fraction than rounded(frac)
  */
 frac frac::humanRounded(unsigned long n) const {
-	bignum bnn(n), bni(bn1);
-	frac closest(rounded(frac(bn1, bni)));
-	frac dist(*this - closest);
-	if (dist.negative())
-		dist.invertSum();
-	for (++bni; bni <= bnn; ++bni) {
-		frac test(rounded(frac(bn1, bni)));
-		frac testDist(*this - test);
-		if (testDist.negative())
-			testDist.invertSum();
-		if (testDist < dist) {
-			closest = test;
-			dist = testDist;
-		}
-	}
-	return closest;
+	bignum p, q;
+	bestApproximation(num.negative()? -num : num, den, bignum(n), p, q);
+	if (num.negative())
+		p.invert();
+	return frac(p, q);
 }
 
 /* semiHumanRounded(unsigned long n) const:
@@ -1335,22 +2571,280 @@ frac frac::semiHumanRounded(unsigned long n) const {
 	return rounded(frac(bn1, ascendingLcm(n)));
 }
 
+/* humanRounded(const std::vector<frac>& v, unsigned long n):
+ * restrictions: n > 0
+ * returns: the vector of the (integer) multiples of 1 / q that are closest to the
+ *          entries of v, for the same q <= n for all entries
+ * note: q is chosen among the denominators of the entries' humanRounded(n) as the one
+ *       with the least maximum rounding error (the smallest one in case of a tie), so
+ *       the returned vector is a small integer vector times 1 / q
+ */
+std::vector<frac> BigNum::humanRounded(const std::vector<frac>& v, unsigned long n) {
+	if (v.empty())
+		return std::vector<frac>();
+
+	std::vector<bignum> candidates;
+	candidates.reserve(v.size());
+	for (std::vector<frac>::const_iterator it = v.begin(); it != v.end(); ++it)
+		candidates.push_back(it->humanRounded(n).denominator());
+	std::sort(candidates.begin(), candidates.end());
+	candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+	// The error of a / b rounded to a multiple of 1 / q is e / (b q), where e is the
+	// distance from a q to the closest multiple of b
+	bignum bestQ;
+	frac bestError;
+	for (std::vector<bignum>::const_iterator qt = candidates.begin();
+		 qt != candidates.end();
+		 ++qt) {
+		bignum maxE, maxB(bn1);
+		for (std::vector<frac>::const_iterator it = v.begin(); it != v.end(); ++it) {
+			bignum e(divide(it->numerator() * *qt, it->denominator()).second);
+			e.removeSignal();
+			bignum comp(it->denominator() - e);
+			if (comp < e)
+				e.swap(comp);
+			if (e * maxB > maxE * it->denominator()) {
+				maxE.swap(e);
+				maxB = it->denominator();
+			}
+		}
+		frac error(maxE, maxB * *qt);
+		if (bestQ.zero() || error < bestError) {
+			bestQ = *qt;
+			bestError.swap(error);
+		}
+	}
+
+	std::vector<frac> rounded;
+	rounded.reserve(v.size());
+	const frac prec(bn1, bestQ);
+	for (std::vector<frac>::const_iterator it = v.begin(); it != v.end(); ++it)
+		rounded.push_back(it->rounded(prec));
+	return rounded;
+}
+
 void frac::swap(frac& other) {
 	num.swap(other.num);
 	den.swap(other.den);
 }
 
-/* reduce() const:
+/* reduce():
  * reduces *this (num and den become co-prime)
  */
-void frac::reduce() const {
+void frac::reduce() {
     if (num.zero()) {
         den = bn1;
         return;
     }
-    bignum g = gcd(num, den);
-    num /= g;
-    den /= g;
+	long a, b;
+	if (num.toLong(a) && den.toLong(b)) {
+		const long g(static_cast<long>(binaryGcd(absolute(a), b)));
+		if (g != 1) {
+			num = bignum(a / g);
+			den = bignum(b / g);
+		}
+		return;
+	}
+    divideByGcd(num, den);
+}
+
+/* addSmall(long a, long b, long c, long d):
+ * restrictions: b, d > 0, a / b and c / d are reduced and none of a, b, c, d is LONG_MIN
+ * makes *this = a / b + c / d (reduced), if this can be done without overflows
+ * returns: true, iff *this was set
+ * note: this is the fast path of frac's additive operators (Knuth, The Art of Computer
+ *       Programming, vol. 2, 4.5.1)
+ */
+bool frac::addSmall(long a, long b, long c, long d) {
+	const long g(static_cast<long>(binaryGcd(b, d)));
+	long t1, t2, t, m;
+	if (!checkedMul(a, d / g, t1) || !checkedMul(c, b / g, t2) || !checkedAdd(t1, t2, t))
+		return false;
+	if (!t) {
+		num = bn0;
+		den = bn1;
+		return true;
+	}
+	// gcd(t, b d / g^2) = 1, so the only common factors of t and the denominator are
+	// the ones of g
+	const long g2(g == 1? 1 : static_cast<long>(binaryGcd(absolute(t), g)));
+	if (!checkedMul(b / g, d / g2, m))
+		return false;
+	num = bignum(t / g2);
+	den = bignum(m);
+	return true;
+}
+
+/* multiplySmall(long a, long b, long c, long d):
+ * restrictions: b, d > 0, a / b and c / d are reduced and none of a, b, c, d is LONG_MIN
+ * makes *this = (a / b) * (c / d) (reduced), if this can be done without overflows
+ * returns: true, iff *this was set
+ * note: this is the fast path of frac's multiplicative operators
+ */
+bool frac::multiplySmall(long a, long b, long c, long d) {
+	if (!a || !c) {
+		num = bn0;
+		den = bn1;
+		return true;
+	}
+	const long g1(static_cast<long>(binaryGcd(absolute(a), d)));
+	const long g2(static_cast<long>(binaryGcd(absolute(c), b)));
+	long n, m;
+	if (!checkedMul(a / g1, c / g2, n) || !checkedMul(b / g2, d / g1, m))
+		return false;
+	num = bignum(n);
+	den = bignum(m);
+	return true;
+}
+
+/* fusedMultiplyAdd(const frac& a, const frac& b, bool subtract):
+ * makes *this = *this + a * b (or *this - a * b, if subtract is true)
+ * returns: *this (after the operation)
+ * note: the crossed factors of a and b are cancelled, so their product p / q is
+ *       reduced, and *this becomes (num q + p den) / (den q), with p den accumulated
+ *       on num q by bignum::fusedMultiplyAdd (only num is multiplied when q == den);
+ *       a single gcd then reduces the result
+ */
+frac& frac::fusedMultiplyAdd(const frac& a, const frac& b, bool subtract) {
+	if (a.zero() || b.zero())
+		return *this;
+	long n, d, an, ad, bn, bd;
+	if (num.toLong(n) && den.toLong(d) && a.num.toLong(an) && a.den.toLong(ad)
+		&& b.num.toLong(bn) && b.den.toLong(bd)) {
+		const long g1(static_cast<long>(binaryGcd(absolute(an), bd)));
+		const long g2(static_cast<long>(binaryGcd(absolute(bn), ad)));
+		long p, q;
+		if (checkedMul(an / g1, bn / g2, p) && checkedMul(ad / g2, bd / g1, q)
+			&& p != LONG_MIN && addSmall(n, d, subtract? -p : p, q))
+			return *this;
+	}
+
+	bignum p1(a.num), q2(b.den), p2(b.num), q1(a.den);
+	divideByGcd(p1, q2);
+	divideByGcd(p2, q1);
+	q1 *= q2;
+	if (den != q1) {
+		num *= q1;
+		p2 *= den;
+		den *= q1;
+	}
+	num.fusedMultiplyAdd(p1, p2, subtract);
+	reduce();
+	return *this;
+}
+
+fracSum::fracSum() : num(), den(bn1) {}
+
+fracSum::fracSum(const frac& f) : num(f.num), den(f.den) {}
+
+fracSum& fracSum::operator+=(const frac& f) {
+	addTerm(f.num, f.den, false);
+	return *this;
+}
+
+fracSum& fracSum::operator-=(const frac& f) {
+	addTerm(f.num, f.den, true);
+	return *this;
+}
+
+/* addmul(const frac& a, const frac& b):
+ * makes *this = *this + a * b
+ * returns: *this (after the operation)
+ * note: the product is not reduced
+ */
+fracSum& fracSum::addmul(const frac& a, const frac& b) {
+	if (!a.zero() && !b.zero())
+		addTerm(a.num * b.num, a.den * b.den, false);
+	return *this;
+}
+
+/* submul(const frac& a, const frac& b):
+ * makes *this = *this - a * b
+ * returns: *this (after the operation)
+ * note: the product is not reduced
+ */
+fracSum& fracSum::submul(const frac& a, const frac& b) {
+	if (!a.zero() && !b.zero())
+		addTerm(a.num * b.num, a.den * b.den, true);
+	return *this;
+}
+
+bool fracSum::zero() const {
+	return num.zero();
+}
+
+/* value() const:
+ * returns: the (reduced) sum accumulated so far
+ */
+frac fracSum::value() const {
+	return frac(num, den);
+}
+
+/* addTerm(const bignum& n, const bignum& d, bool subtract):
+ * restrictions: d > 0
+ * makes *this = *this + n / d (or *this - n / d, if subtract is true)
+ * note: no gcd is computed when d divides the current denominator (which is the usual
+ *       case after the first few terms of a sum)
+ */
+void fracSum::addTerm(const bignum& n, const bignum& d, bool subtract) {
+	if (n.zero())
+		return;
+	if (d == den) {
+		subtract? num -= n : num += n;
+		return;
+	}
+	divRes dr(divide(den, d));
+	if (!dr.second.zero()) {
+		// den becomes lcm(den, d)
+		bignum g(gcd(den, d));
+		bignum factor(d / g);
+		dr.first = den / g;
+		num *= factor;
+		den *= factor;
+	}
+	subtract? num.submul(n, dr.first) : num.addmul(n, dr.first);
+}
+
+/* assignDecimal(bool negative, const char *digits, unsigned long n, long exponent):
+ * restrictions: digits[0..n-1] are decimal digits
+ * makes *this = digits[0..n-1] * 10^exponent (with signal - if negative is true)
+ * note: the digits are converted at once and, since the denominator is a power of 10,
+ *       the reduction only removes factors 2 or 5 (without computing any gcd)
+ */
+void frac::assignDecimal(bool negative, const char *digits, unsigned long n, long exponent) {
+	den = bn1;
+	for ( ; n && digits[n-1] == '0'; --n)
+		++exponent;
+	for ( ; n && *digits == '0'; --n)
+		++digits;
+	if (!n) {
+		num = bn0;
+		return;
+	}
+	num = bignum::fromDigits(digits, n, decimal);
+	if (exponent >= 0)
+		num *= pow(bn10, exponent);
+	else {
+		// num is not a multiple of 10, so it is not a multiple of both 2 and 5
+		unsigned long twos(-exponent), fives(-exponent);
+		if (!(num.v[0] & 1)) {
+			unsigned long zeros = 0;
+			while (zeros < twos
+				   && !((num.v[zeros / bignum::bitsElem] >> (zeros % bignum::bitsElem)) & 1))
+				++zeros;
+			num >>= zeros;
+			twos -= zeros;
+		}
+		else {
+			for ( ; fives && !num.residue(5); --fives)
+				num.divideByElem(5);
+		}
+		den = pow(bignum(5), fives);
+		den <<= twos;
+	}
+	if (negative)
+		num.invert();
 }
 
 /* pow(bignum b, unsigned long e):
@@ -1383,7 +2877,18 @@ frac BigNum::pow(frac b, long e) {
     return r;
 }
 
+/* divide(bignum num, bignum den):
+ * restrictions: den is non-zero
+ * returns: the quotient (rounded towards zero) and the remainder (with the signal of
+ *          num) of the division of num by den
+ * note: uses Knuth's algorithm D (The Art of Computer Programming, vol. 2, 4.3.1) on
+ *       the elements, with a fast path for dens of a single element
+ */
 divRes BigNum::divide(bignum num, bignum den) {
+	typedef bignum::elem_t elem_t;
+	typedef bignum::wide_t wide_t;
+	const size_t bitsElem(bignum::bitsElem);
+
 	if (den.zero())
 		throw divisionBy0();
 	bool numSgn(num.negative()), denSgn(den.negative());
@@ -1395,18 +2900,71 @@ divRes BigNum::divide(bignum num, bignum den) {
 		return divRes(bn0, num);
 	}
 
+	bignum quot;
+	if (den.v.size() == 1) {
+		const elem_t rem(num.divideByElem(den.v[0]));
+		quot.swap(num);
+		if (rem)
+			num.v.push_back(rem);
+	}
+	else {
+		const unsigned long n(den.v.size()), m(num.v.size() - n);
+
+		// Normalization: the most significant bit of den becomes 1
+		unsigned long s = 0;
+		for (elem_t top(den.v.back()); !(top >> (bitsElem - 1)); top <<= 1)
+			++s;
+		den <<= s;
+		num <<= s;
+		num.v.resize(m + n + 1);
+		bignum::elemVector& u(num.v);
+		const bignum::elemVector& d(den.v);
+		const wide_t base(static_cast<wide_t>(1) << bitsElem);
+
+		quot.v.resize(m + 1);
+		for (unsigned long j = m + 1; j > 0; ) {
+			--j;
+			// Estimates the quotient digit from the two most significant elements of
+			// the current remainder (the estimate is at most 2 over the real digit
+			// before the correction below and at most 1 over it after)
+			const wide_t top((static_cast<wide_t>(u[j + n]) << bitsElem) + u[j + n - 1]);
+			wide_t qhat(top / d[n - 1]), rhat(top % d[n - 1]);
+			while (qhat >= base
+				   || qhat * d[n - 2] > (rhat << bitsElem) + u[j + n - 2]) {
+				--qhat;
+				rhat += d[n - 1];
+				if (rhat >= base)
+					break;
+			}
 
-	const unsigned long shift((num.v.size() - den.v.size() + 1) * bignum::bitsElem);
-	den <<= shift;
-	bignum quot, pow2(bn1 << shift);
-    while (!pow2.zero()) {
-		if (den <= num) {
-			quot += pow2;
-			num -= den;
+			// Multiplies and subtracts
+			wide_t carry = 0;
+			bool borrow = false;
+			for (unsigned long i = 0; i < n; ++i) {
+				const wide_t p(qhat * d[i] + carry);
+				carry = p >> bitsElem;
+				const elem_t pLow(static_cast<elem_t>(p)), ui(u[i + j]);
+				u[i + j] = static_cast<elem_t>(ui - pLow - borrow);
+				borrow = ui < pLow || (ui == pLow && borrow);
+			}
+			const elem_t ui(u[j + n]), c(static_cast<elem_t>(carry));
+			u[j + n] = static_cast<elem_t>(ui - c - borrow);
+			borrow = ui < c || (ui == c && borrow);
+
+			// Adds back in the rare case that the estimate was still 1 too big
+			if (borrow) {
+				--qhat;
+				u[j + n] = static_cast<elem_t>(u[j + n]
+											   + bignum::addToElems(&u[j], n, &d[0], n));
+			}
+			quot.v[j] = static_cast<elem_t>(qhat);
 		}
-		den >>= 1;
-		pow2 >>= 1;
+		quot.adjust();
+		u.resize(n);
+		num.adjust();
+		num >>= s;
 	}
+
 	if (numSgn xor denSgn)
 		quot.invert();
 	if (numSgn)
@@ -1414,32 +2972,19 @@ divRes BigNum::divide(bignum num, bignum den) {
 	return divRes(quot, num);
 }
 
+/* divide(frac f1, frac f2):
+ * restrictions: f2 is non-zero
+ * returns: the quotient (rounded towards zero) and the remainder (with the signal of
+ *          f1) of the division of f1 by f2
+ */
 fracDivRes BigNum::divide(frac f1, frac f2) {
 	if (f2.zero())
 		throw divisionBy0();
-	bool f1Sgn(f1.negative()), f2Sgn(f2.negative());
-	f1.removeSignal();
-	f2.removeSignal();
-
-	bignum quot, pow2(bn1);
-	while (f1 >= f2) {
-		f2.num <<= 1;
-		pow2 <<= 1;
-	}
 
-    while (!pow2.zero()) {
-		if (f2 <= f1) {
-			quot += pow2;
-			f1 -= f2;
-		}
-		f2.num >>= 1;
-		pow2 >>= 1;
-	}
-	if (f1Sgn xor f2Sgn)
-		quot.invert();
-	if (f1Sgn)
-		f1.invertSum();
-	return fracDivRes(quot, f1);
+	// f1 / f2 = (f1.num f2.den) / (f1.den f2.num) and the remainder of this integer
+	// division is the numerator of the remainder over f1.den f2.den
+	divRes dr(divide(f1.num * f2.den, f1.den * f2.num));
+	return fracDivRes(dr.first, frac(dr.second, f1.den * f2.den));
 }
 
 /* stringToBignum(const std::string& str, base b):
@@ -1488,11 +3033,13 @@ const bignum& BigNum::factorial(unsigned long n) {
 /* decrescentfactorial(unsigned long n, unsigned long k):
  * restrictions: k <= n
  * returns: n*(n-1)*(n-2)*...*(n-k+1)
+ * note: the values are memoized (the table may be used from several threads)
  */
 const bignum& BigNum::decrescentfactorial(unsigned long n, unsigned long k) {
 	static std::deque< std::deque<bignum> > mem;
 	if (k == 0)
 		return bn1;
+	std::lock_guard<std::recursive_mutex> lock(memoMutex);
 	if (n == 0)
 		return bn0;
 	if (n > mem.size())
@@ -1506,11 +3053,13 @@ const bignum& BigNum::decrescentfactorial(unsigned long n, unsigned long k) {
 
 /* binomial(unsigned long n, unsigned long k):
  * restrictions: k <= n
+ * note: the values are memoized (the table may be used from several threads)
  */
 const bignum& BigNum::binomial(unsigned long n, unsigned long k) {
 	static std::deque< std::deque<bignum> > mem;
 	if (k == 0 || k == n)
 		return bn1;
+	std::lock_guard<std::recursive_mutex> lock(memoMutex);
 	if (n-1 > mem.size())
 		mem.resize(n-1);
 	if (!mem[n-2].size())
@@ -1523,23 +3072,75 @@ const bignum& BigNum::binomial(unsigned long n, unsigned long k) {
 /* gcd(bignum a, bignum b):
  * restrictions: at least one of a or b is non-zero
  * returns: the greatest common divisor of a and b
+ * note: uses Lehmer's algorithm (Knuth, The Art of Computer Programming, vol. 2, 4.5.2,
+ *       algorithm L) while the operands do not fit in an unsigned long and the binary
+ *       algorithm after that
  */
 bignum BigNum::gcd(bignum a, bignum b) {
-    bignum c;
-    bignum *d1 = &a, *d2 = &b, *r = &c;
+	const unsigned long bitsLong(sizeof(unsigned long) * CHAR_BIT);
+	// Precision of the leading bits used in Lehmer's steps (with this many bits, all
+	// cofactors and intermediate products of a step fit in a long)
+	const unsigned long precision(bitsLong - 3);
+
 	a.removeSignal();
 	b.removeSignal();
-    if (b.zero()) {
+	if (a < b)
+		a.swap(b);
+
+	while (b.bitLength() > bitsLong) {
+		// Simulates Euclid's algorithm on the leading bits of a and b for as long as the
+		// quotients are guaranteed to be the same as the ones of a and b
+		const unsigned long shift(a.bitLength() - precision);
+		long x(static_cast<long>(a.shiftedBits(shift)));
+		long y(static_cast<long>(b.shiftedBits(shift)));
+		long A = 1, B = 0, C = 0, D = 1;
+		while (y + C && y + D) {
+			const long q((x + A) / (y + C));
+			if (q != (x + B) / (y + D))
+				break;
+			long t(A - q * C);
+			A = C;
+			C = t;
+			t = B - q * D;
+			B = D;
+			D = t;
+			t = x - q * y;
+			x = y;
+			y = t;
+		}
+
+		if (!B) {
+			// No quotient could be determined: does a full division step
+			bignum r(a % b);
+			a.swap(b);
+			b.swap(r);
+		}
+		else {
+			bignum na(a * bignum(A) + b * bignum(B));
+			b = a * bignum(C) + b * bignum(D);
+			a.swap(na);
+		}
+	}
+
+	if (b.zero())
 		return a;
-    }
+	const unsigned long small(b.shiftedBits(0));
+	return bignum::fromUnsignedLong(binaryGcd(small, (a % b).shiftedBits(0)));
+}
 
-    for (*r = *d1 % *d2; !r->zero(); *r = *d1 % *d2) {
-        bignum *aux = d1;
-        d1 = d2;
-        d2 = r;
-        r = aux;
-    }
-    return *d2;
+/* divideByGcd(bignum& a, bignum& b):
+ * restrictions: at least one of a or b is non-zero
+ * divides a and b by their greatest common divisor
+ * returns: the greatest common divisor of a and b
+ * note: the divisions are skipped when a and b are already co-prime
+ */
+bignum BigNum::divideByGcd(bignum& a, bignum& b) {
+	bignum g(gcd(a, b));
+	if (g != bn1) {
+		a /= g;
+		b /= g;
+	}
+	return g;
 }
 
 /* lcm(const bignum& a, const bignum& b):
@@ -1559,6 +3160,7 @@ bignum BigNum::ascendingLcm(unsigned long n) {
 	static std::deque<bignum> mem;
 	if (n <= 1)
 		return bn1;
+	std::lock_guard<std::recursive_mutex> lock(memoMutex);
 	if (mem.size() < n-1)
 		mem.resize(n-1);
 	if (mem[n-2].zero())
@@ -1600,14 +3202,29 @@ double BigNum::fracToDouble(const frac& f) {
 }
 
 /* doubleToFrac(double d):
- * returns: frac that represents d
+ * returns: frac that represents d exactly (or 0, if d is not finite)
+ * note: the value is decoded from the mantissa and the power of two exponent of d
  */
 frac BigNum::doubleToFrac(double d) {
 	frac f;
-	std::stringstream s;
-	s.precision(30);
-	s << d;
-	s >> f;
+	if (d == 0 || !std::isfinite(d))
+		return f;
+	int e;
+	// the mantissa as an integer (exact, since it has DBL_MANT_DIG <= 64 bits)
+	unsigned long long m(static_cast<unsigned long long>(ldexp(frexp(fabs(d), &e),
+																DBL_MANT_DIG)));
+	e -= DBL_MANT_DIG;
+	for ( ; !(m & 1); m >>= 1)
+		++e;
+	f.num = bignum(static_cast<long>(m >> 32));
+	f.num <<= 32;
+	f.num += bignum(static_cast<long>(m & 0xffffffffUL));
+	if (e >= 0)
+		f.num <<= e;
+	else
+		f.den <<= -e;
+	if (d < 0)
+		f.num.invert();
 	return f;
 }
 
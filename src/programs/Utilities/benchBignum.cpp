@@ -0,0 +1,170 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <ctime>
+#include <cstdlib>
+
+#include "bignum.h"
+#include "getoptions.h"
+
+using namespace std;
+using namespace BigNum;
+
+/* This program times the exact arithmetic workloads of the SDP programs
+ * (parsing, products of fractions, long sums, big integer division and multiplication
+ * and printing)
+ * on the entries of the solution files in results/ (or on the files given as
+ * arguments). Compare the output of benchBignum and benchBignumLegacy (the latter
+ * is compiled with the original byte-sized limbs) to see the effect of the limb size.
+ */
+
+// Default solution files used as workload
+static const char* defaultFiles[] = {
+	"results/T7_rounded.txt",
+	"results/T7_rounded_squares.txt",
+	"results/T8_rounded.txt",
+	"results/T9_rounded.txt",
+	"results/T11_rounded.txt",
+	"results/T12_rounded.txt"
+};
+
+/* readEntries(const char *filename, vector<string>& entries):
+ * appends to entries the values of the lines "b i j value" of file filename
+ * returns: false, iff the file could not be opened
+ */
+static bool readEntries(const char *filename, vector<string>& entries) {
+	ifstream in(filename);
+	if (!in.good())
+		return false;
+	string line;
+	while (getline(in, line)) {
+		istringstream ss(line);
+		unsigned long b, i, j;
+		if (ss >> b >> i >> j) {
+			string value;
+			getline(ss, value);
+			if (value.find_first_not_of(" \t") != string::npos)
+				entries.push_back(value);
+		}
+	}
+	return true;
+}
+
+/* elapsed(clock_t start):
+ * returns: seconds elapsed since start
+ */
+static double elapsed(clock_t start) {
+	return static_cast<double>(clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char **argv) {
+	unsigned long repetitions = 20;
+
+	int ind1 = 1, ind2 = 0;
+	char opt;
+	const char* arg = "";
+	while (Text::getoptions("r:", ind1, ind2, opt, arg, argc, argv)) {
+		switch (opt) {
+		case 'r':
+			repetitions = strtoul(arg, 0, 10);
+			break;
+		case ':':
+			cerr << "Missing argument for option: " << *arg << "\n";
+			return 1;
+		case '\0':
+			cerr << "Usage: " << argv[0] << " [-r repetitions] [solution files]\n";
+			return 1;
+		}
+	}
+
+	vector<string> entries;
+	if (ind1 < argc) {
+		for (int i = ind1; i < argc; ++i)
+			if (!readEntries(argv[i], entries))
+				cerr << "Warning: unable to open file " << argv[i] << "\n";
+	}
+	else {
+		for (unsigned long i = 0; i < sizeof(defaultFiles)/sizeof(*defaultFiles); ++i)
+			if (!readEntries(defaultFiles[i], entries))
+				cerr << "Warning: unable to open file " << defaultFiles[i] << "\n";
+	}
+	if (!entries.size()) {
+		cerr << "Error: no solution entries read.\n";
+		return 1;
+	}
+
+	cout << "Limb size: " << BIGNUM_LIMB_BITS << " bits\n"
+		 << "Entries: " << entries.size() << "\n"
+		 << "Repetitions: " << repetitions << "\n\n";
+
+	vector<frac> values(entries.size());
+	clock_t start(clock());
+	for (unsigned long r = 0; r < repetitions; ++r)
+		for (unsigned long i = 0; i < entries.size(); ++i)
+			values[i] = stringToFrac(entries[i]);
+	cout << "parse:   " << elapsed(start) << "s\n";
+
+	// Products of entries with flag-like normalizing factors (as in SDPchecker)
+	frac acc;
+	start = clock();
+	for (unsigned long r = 0; r < repetitions; ++r) {
+		acc = frac();
+		for (unsigned long i = 0; i < values.size(); ++i) {
+			const unsigned long j((i * 7 + r) % values.size());
+			acc += values[i] * values[j]
+				* frac(bignum(static_cast<long>(i % 13 + 1)),
+					   decrescentfactorial(9, 3) * binomial(6, i % 7));
+		}
+	}
+	cout << "product: " << elapsed(start) << "s\n";
+
+	// Long sums whose denominators grow (as in the final coefficients)
+	frac sum;
+	start = clock();
+	for (unsigned long r = 0; r < repetitions; ++r) {
+		sum = frac();
+		for (unsigned long i = 0; i < values.size(); ++i)
+			sum += values[i] / frac(static_cast<long>(i % 97 + 1));
+	}
+	cout << "sum:     " << elapsed(start) << "s\n";
+
+	// Big integer arithmetic
+	bignum big;
+	start = clock();
+	for (unsigned long r = 0; r < repetitions; ++r) {
+		bignum a(pow(bignum(3), 600 + r)), b(pow(bignum(7), 250 + r));
+		big = gcd(a * b + bn1, a - b) + (a * b) / b % pow(bignum(11), 100);
+	}
+	cout << "bigint:  " << elapsed(start) << "s\n";
+
+	// Products and squares of very big integers (as in long certificates)
+	bignum bigProd;
+	start = clock();
+	for (unsigned long r = 0; r < repetitions; ++r) {
+		bignum a(pow(bignum(3), 20000 + r)), b(pow(bignum(7), 12000 + r));
+		bigProd = a * b + a * a;
+	}
+	cout << "bigmul:  " << elapsed(start) << "s\n";
+
+	// Printing (as in fprintSDPproblem and the solution writers)
+	unsigned long chars = 0;
+	start = clock();
+	for (unsigned long r = 0; r < repetitions; ++r) {
+		for (unsigned long i = 0; i < values.size(); ++i)
+			chars += values[i].toStringPoint(16).size();
+		chars += acc.toStringDec().size() + sum.toStringPoint(16).size()
+			+ big.toStringDec().size() + bigProd.toStringHex().size();
+	}
+	cout << "print:   " << elapsed(start) << "s\n";
+
+	// Printing the results guarantees that the computations are not optimized away
+	cout << "\nChecksum: " << chars << " " << sum.toStringPoint(16) << "\n";
+	return 0;
+}
+
+/* Local Variables: */
+/* mode: c++ */
+/* tab-width: 4 */
+/* End: */